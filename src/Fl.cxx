@@ -48,11 +48,14 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Window.H>
 #include <FL/Fl_Tooltip.H>
+#include <FL/Fl_Widget_Arena.H>
 #include <FL/x.H>
 
 #include <ctype.h>
 #include <stdlib.h>
 #include "flstring.h"
+#include "fl_loop_stats.h"
+#include "Fl_Hash_Table.H"
 
 #if defined(DEBUG) || defined(DEBUG_WATCH)
 #  include <stdio.h>
@@ -462,7 +465,10 @@ static void run_checks()
     while (next_check) {
       Check* checkp = next_check;
       next_check = checkp->next;
+      Fl_Timeout_Handler cb = checkp->cb;
+      double t0 = fl_loop_stat_start();
       (checkp->cb)(checkp->arg);
+      fl_loop_stat_end(FL_LOOP_CHECK, (const void*)cb, t0);
     }
     next_check = first_check;
   }
@@ -536,6 +542,187 @@ void fl_trigger_clipboard_notify(int source) {
   }
 }
 
+////////////////////////////////////////////////////////////////
+// Frame pacing:
+//
+// If a frame rate is set, the flush done by Fl::wait() is held back
+// until one frame interval has passed since the previous flush, so
+// damage from fast timers or awake callbacks is coalesced. Input events
+// force the next flush to happen immediately to keep latency low.
+// Frame handlers are one-shot callbacks run at the start of the next
+// frame, they are called in the order they were added.
+
+struct Frame_Handler {
+  Fl_Window *window;
+  Fl_Frame_Handler cb;
+  void *arg;
+  Frame_Handler *next;
+};
+static Frame_Handler *first_frame, *next_frame, *free_frame;
+static double frame_rate_;	// 0 means flush after every event batch
+static double last_frame;	// time of the last paced flush
+static char frame_now;		// flush at the next opportunity
+static char frame_scheduled;	// the frame handler timeout is pending
+
+#ifndef WIN32
+#  include <sys/time.h>
+#endif
+
+static double frame_clock() {
+#ifdef WIN32
+  return GetTickCount() / 1000.0;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+// Frame handlers run at 60 Hz unless a frame rate is set:
+static double frame_interval() {
+  return 1.0 / (frame_rate_ > 0.0 ? frame_rate_ : 60.0);
+}
+
+// Returns the time until the next frame is due, 0 if it is due now:
+static double frame_delay() {
+  double left = last_frame + frame_interval() - frame_clock();
+  return left > 0.0 ? left : 0.0;
+}
+
+static void run_frame_handlers(void *) {
+  frame_scheduled = 0;
+  last_frame = frame_clock();
+  // handlers added from inside a handler are run in the next frame:
+  next_frame = first_frame;
+  first_frame = 0;
+  Frame_Handler *f;
+  while ((f = next_frame)) {
+    next_frame = f->next;
+    Fl_Window *win = f->window;
+    Fl_Frame_Handler cb = f->cb;
+    void *argp = f->arg;
+    f->next = free_frame;
+    free_frame = f;
+    if (win->shown()) cb(win, argp);
+  }
+  frame_now = 1;
+}
+
+#if !defined(WIN32) && !defined(__APPLE__)
+// The flush done by Fl::wait(), skipped while the current frame is not due:
+static void flush_frame() {
+  if (frame_rate_ > 0.0 && Fl::damage() && !frame_now && frame_delay() > 0.0) {
+    if (fl_display) XFlush(fl_display);
+    return;
+  }
+  Fl::flush();
+}
+#endif
+
+/**
+  Sets the maximum number of times per second that Fl::wait() flushes
+  the display.
+
+  By default (\p hz = 0) the display is flushed after every batch of
+  events, so an application calling redraw() from a fast timer repaints
+  just as fast. With a frame rate set, damage is coalesced and flushed
+  at most once per frame interval. Input events such as FL_PUSH,
+  FL_KEYDOWN or FL_DRAG still cause an immediate flush to keep the
+  interface responsive. Explicit calls to Fl::flush() are not affected.
+
+  The frame rate also sets the rate at which frame handlers are called,
+  see Fl::add_frame_handler().
+
+  \note Holding back the flush is currently only implemented on X11.
+
+  \param[in] hz frames per second, or 0 to disable frame pacing
+*/
+void Fl::frame_rate(double hz) {
+  frame_rate_ = hz > 0.0 ? hz : 0.0;
+  frame_now = 1;
+}
+
+/**
+  Returns the current frame rate, 0 if frame pacing is disabled.
+  \see Fl::frame_rate(double)
+*/
+double Fl::frame_rate() {
+  return frame_rate_;
+}
+
+/**
+  Requests a call of \p cb at the start of the next frame of window \p win.
+
+  This is a one-shot callback similar to a timeout, but it is synchronized
+  with the display flush: the handler is called just before the frame is
+  drawn, so animation code can update its state, call redraw(), and add
+  itself again to be called for the following frame. Frames are paced at
+  Fl::frame_rate(), or 60 times per second if no frame rate is set.
+
+  Adding a handler that is already pending for the same window and data
+  does nothing. Pending handlers are removed when the window is hidden.
+
+  \code
+  void animate(Fl_Window *win, void *data) {
+    advance_animation(data);
+    win->redraw();
+    if (!animation_done(data)) Fl::add_frame_handler(win, animate, data);
+  }
+  \endcode
+
+  \see Fl::remove_frame_handler(), Fl::frame_rate(double)
+*/
+void Fl::add_frame_handler(Fl_Window *win, Fl_Frame_Handler cb, void *argp) {
+  Frame_Handler **p = &first_frame;
+  for (; *p; p = &((*p)->next))
+    if ((*p)->window == win && (*p)->cb == cb && (*p)->arg == argp) return;
+  Frame_Handler *f = free_frame;
+  if (f) free_frame = f->next;
+  else f = new Frame_Handler;
+  f->window = win;
+  f->cb = cb;
+  f->arg = argp;
+  f->next = 0;
+  *p = f;
+  if (!frame_scheduled) {
+    frame_scheduled = 1;
+    add_timeout(frame_delay(), run_frame_handlers);
+  }
+}
+
+/**
+  Returns 1 if the frame handler is pending for window \p win, 0 otherwise.
+*/
+int Fl::has_frame_handler(Fl_Window *win, Fl_Frame_Handler cb, void *argp) {
+  for (Frame_Handler *f = first_frame; f; f = f->next)
+    if (f->window == win && f->cb == cb && f->arg == argp) return 1;
+  for (Frame_Handler *f = next_frame; f; f = f->next)
+    if (f->window == win && f->cb == cb && f->arg == argp) return 1;
+  return 0;
+}
+
+/**
+  Removes a frame handler of window \p win. It is harmless to remove a
+  frame handler that no longer exists.
+
+  If \p cb is NULL, all frame handlers of the window are removed.
+*/
+void Fl::remove_frame_handler(Fl_Window *win, Fl_Frame_Handler cb, void *argp) {
+  Frame_Handler **lists[2] = { &first_frame, &next_frame };
+  for (int i = 0; i < 2; i++) {
+    for (Frame_Handler **p = lists[i]; *p;) {
+      Frame_Handler *f = *p;
+      if (f->window == win && (!cb || (f->cb == cb && f->arg == argp))) {
+        *p = f->next;
+        f->next = free_frame;
+        free_frame = f;
+      } else {
+        p = &(f->next);
+      }
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////
 // wait/run/check/ready:
 
@@ -576,7 +763,9 @@ double Fl::wait(double time_to_wait) {
       t->next = free_timeout;
       free_timeout = t;
       // Now it is safe for the callback to do add_timeout:
+      double t0 = fl_loop_stat_start();
       cb(argp);
+      fl_loop_stat_end(FL_LOOP_TIMEOUT, (const void*)cb, t0);
     }
   } else {
     reset_clock = 1; // we are not going to check the clock
@@ -597,13 +786,16 @@ double Fl::wait(double time_to_wait) {
   if (time_to_wait <= 0.0) {
     // do flush second so that the results of events are visible:
     int ret = fl_wait(0.0);
-    flush();
+    flush_frame();
     return ret;
   } else {
     // do flush first so that user sees the display:
-    flush();
+    flush_frame();
     if (idle && !in_idle) // 'idle' may have been set within flush()
       time_to_wait = 0.0;
+    // wake up in time to flush damage held back by frame pacing:
+    if (damage_ && frame_rate_ > 0.0 && frame_delay() < time_to_wait)
+      time_to_wait = frame_delay();
     return fl_wait(time_to_wait);
   }
 #endif
@@ -704,6 +896,56 @@ int Fl::ready() {
   return fl_ready();
 }
 
+////////////////////////////////////////////////////////////////
+// Event compression:
+
+char fl_compress_events;		// used by Fl_x.cxx
+unsigned long fl_compressed_motion;	// motion events dropped
+unsigned long fl_compressed_expose;	// expose events merged
+
+/**
+  Turns compression of system events on or off.
+
+  With compression on, FLTK looks ahead in the queue of system events
+  before dispatching them. A sequence of expose events for a window is
+  merged into one damage rectangle covering all of them.
+
+  Pointer motion is always compressed on X11, whatever this setting:
+  of all the motion events read from the server in one go, only the
+  last one is sent as FL_MOVE or FL_DRAG, so a slow handle() or draw()
+  does not fall behind a fast mouse. Fl::event_compression_counts()
+  reports the motion events dropped this way.
+
+  Compression is off by default.
+
+  \note This is currently only implemented on X11.
+
+  \see Fl::event_compression_counts()
+*/
+void Fl::event_compression(int on) {
+  fl_compress_events = on ? 1 : 0;
+}
+
+/**
+  Returns non-zero if system events are compressed.
+  \see Fl::event_compression(int)
+*/
+int Fl::event_compression() {
+  return fl_compress_events;
+}
+
+/**
+  Returns how many system events were removed by event compression.
+
+  \param[out] motion number of pointer motion events dropped
+  \param[out] expose number of expose events merged into another one
+  \see Fl::event_compression(int)
+*/
+void Fl::event_compression_counts(unsigned long &motion, unsigned long &expose) {
+  motion = fl_compressed_motion;
+  expose = fl_compressed_expose;
+}
+
 ////////////////////////////////////////////////////////////////
 // Window list management:
 
@@ -779,13 +1021,23 @@ void Fl::redraw() {
   event queue.
 */
 void Fl::flush() {
+  layout();
   if (damage()) {
+    if (frame_rate_ > 0.0) {
+      last_frame = frame_clock();
+      frame_now = 0;
+    }
     damage_ = 0;
     for (Fl_X* i = Fl_X::first; i; i = i->next) {
       if (i->wait_for_expose) {damage_ = 1; continue;}
       Fl_Window* wi = i->w;
       if (!wi->visible_r()) continue;
-      if (wi->damage()) {i->flush(); wi->clear_damage();}
+      if (wi->damage()) {
+        double t0 = fl_loop_stat_start();
+        i->flush();
+        wi->clear_damage();
+        fl_loop_stat_end(FL_LOOP_FLUSH, wi, t0);
+      }
       // destroy damage regions for windows that don't use them:
       if (i->region) {XDestroyRegion(i->region); i->region = 0;}
     }
@@ -1256,6 +1508,9 @@ Fl_Event_Dispatch Fl::event_dispatch()
 }
 
 
+extern char fl_record_events; // in Fl_Event_Recorder.cxx
+extern void fl_record_event(int e, Fl_Window *window);
+
 /**
  \brief Handle events from the window system.
 
@@ -1274,11 +1529,23 @@ Fl_Event_Dispatch Fl::event_dispatch()
  */
 int Fl::handle(int e, Fl_Window* window)
 {
+  static int depth;	// only record events from the system, not recursive calls
+  switch (e) {
+    case FL_PUSH: case FL_RELEASE: case FL_DRAG: case FL_MOVE:
+    case FL_KEYDOWN: case FL_KEYUP: case FL_MOUSEWHEEL:
+      frame_now = 1; // don't hold back the response to user input
+      break;
+  }
+  if (fl_record_events && !depth) fl_record_event(e, window);
+  depth++;
+  int ret;
   if (e_dispatch) {
-    return e_dispatch(e, window);
+    ret = e_dispatch(e, window);
   } else {
-    return handle_(e, window);
+    ret = handle_(e, window);
   }
+  depth--;
+  return ret;
 }
 
 
@@ -1298,6 +1565,7 @@ int Fl::handle(int e, Fl_Window* window)
 int Fl::handle_(int e, Fl_Window* window)
 {
   e_number = e;
+  layout();
   if (fl_local_grab) return fl_local_grab(e);
 
   Fl_Widget* wi = window;
@@ -1450,7 +1718,7 @@ int Fl::handle_(int e, Fl_Window* window)
     if (!wi) {
       wi = modal();
       if (!wi) wi = window;
-    } else if (wi->window() != first_window()) {
+    } else if (first_window() && wi->window() != first_window()) {
       if (send_event(FL_SHORTCUT, first_window(), first_window())) return 1;
     }
 
@@ -1553,6 +1821,7 @@ void Fl_Window::hide() {
   }
 #endif
   clear_visible();
+  Fl::remove_frame_handler(this);
 
   if (!shown()) return;
 
@@ -1834,6 +2103,10 @@ void Fl_Widget::damage(uchar fl) {
     if (!i) return; // window not mapped, so ignore it
     if (i->region) {XDestroyRegion(i->region); i->region = 0;}
     damage_ |= fl;
+#if FLTK_ABI_VERSION >= 10304
+    if ((fl & FL_DAMAGE_CHILD) && ((Fl_Window*)this)->index_)
+      ((Fl_Window*)this)->child_damaged(this);
+#endif
     Fl::damage(FL_DAMAGE_CHILD);
   }
 }
@@ -1841,8 +2114,18 @@ void Fl_Widget::damage(uchar fl) {
 void Fl_Widget::damage(uchar fl, int X, int Y, int W, int H) {
   Fl_Widget* wi = this;
   // mark all parent widgets between this and window with FL_DAMAGE_CHILD:
+#if FLTK_ABI_VERSION >= 10304
+  // and tell those with a spatial index which of their children to draw
+  if ((fl & FL_DAMAGE_CHILD) && as_group() && as_group()->index_)
+    as_group()->child_damaged(this);
+#endif
   while (wi->type() < FL_WINDOW) {
     wi->damage_ |= fl;
+#if FLTK_ABI_VERSION >= 10304
+    // Fl_Value_Input makes itself the parent of its input, so check:
+    Fl_Group *p = wi->parent() ? wi->parent()->as_group() : 0;
+    if (p && p->index_) p->child_damaged(wi);
+#endif
     wi = wi->parent();
     if (!wi) return;
     fl = FL_DAMAGE_CHILD;
@@ -1993,16 +2276,40 @@ void Fl::do_widget_deletion() {
   if (!num_dwidgets) return;
 
   for (int i = 0; i < num_dwidgets; i ++)
-    delete dwidgets[i];
+    Fl_Widget_Arena::destroy(dwidgets[i]);
 
   num_dwidgets = 0;
 }
 
 
+// There are two watch lists. The pointers given to
+// Fl::watch_widget_pointer() are kept in an array and searched, because
+// the program may assign another widget to them while they are watched.
+// The pointers of Fl_Widget_Tracker, which FLTK creates for every event
+// and callback, can not be changed from outside, so they are kept in a
+// hash table under the widget they point to. Fl::clear_widget_pointer()
+// then only looks at the trackers of the deleted widget. Trackers whose
+// widget was deleted are hashed by their own address until they are
+// released.
+
 static Fl_Widget ***widget_watch = 0;
 static int num_widget_watch = 0;
 static int max_widget_watch = 0;
 
+static Fl_Hash_Table<Fl_Widget**> *trackers = 0; // see Fl_Hash_Table.H
+
+static unsigned tracker_hash(Fl_Widget *const *wp) {
+  return Fl_Hash_Table<Fl_Widget**>::hash_pointer(*wp ? (const void*)*wp : (const void*)wp);
+}
+
+static void watch_tracker(Fl_Widget **wp) {
+  if (!trackers) trackers = new Fl_Hash_Table<Fl_Widget**>;
+  trackers->insert(wp, tracker_hash(wp));
+}
+
+static void release_tracker(Fl_Widget **wp) {
+  trackers->remove(wp, tracker_hash(wp));
+}
 
 /**
   Adds a widget pointer to the widget watch list.
@@ -2047,6 +2354,12 @@ static int max_widget_watch = 0;
    callbacks is to use the class Fl_Widget_Tracker with a local (automatic)
    variable.
 
+   \note The pointers added with this method are kept in an array, because
+   the program may assign another widget to them while they are watched.
+   Adding and releasing one, and deleting any widget, take time proportional
+   to the number of watched pointers. Only the pointers of Fl_Widget_Tracker
+   are kept in a hash table and take constant time.
+
    \see class Fl_Widget_Tracker
 */
 void Fl::watch_widget_pointer(Fl_Widget *&w)
@@ -2113,7 +2426,11 @@ void Fl::release_widget_pointer(Fl_Widget *&w)
   \note Internal use only !
 
   This method searches the widget watch list for pointers to the widget and
-  clears each pointer that points to it. Widget pointers can be added to the
+  clears each pointer that points to it. The pointers of Fl_Widget_Tracker
+  objects are found in constant time, no matter how many are alive. The
+  pointers given to Fl::watch_widget_pointer() are not hashed: all of them
+  are checked, in time proportional to their number. Widget pointers
+  can be added to the
   widget watch list by calling Fl::watch_widget_pointer() or by using the
   helper class Fl_Widget_Tracker (recommended).
 
@@ -2129,6 +2446,17 @@ void Fl::clear_widget_pointer(Fl_Widget const *w)
       *widget_watch[i] = 0L;
     }
   }
+  if (!trackers) return;
+  i = trackers->first(trackers->hash_pointer(w));
+  while (i >= 0) {
+    Fl_Widget **wp = trackers->key(i);
+    if (*wp != w) {i = trackers->next(i); continue;}
+    // keep it under its own address until it is released:
+    trackers->remove_at(i);
+    *wp = 0L;
+    trackers->insert(wp, tracker_hash(wp));
+    if (!trackers->key(i)) break;	// the end of the probe sequence
+  }
 }
 
 
@@ -2249,7 +2577,7 @@ void Fl::option(Fl_Option opt, bool val)
 Fl_Widget_Tracker::Fl_Widget_Tracker(Fl_Widget *wi)
 {
   wp_ = wi;
-  Fl::watch_widget_pointer(wp_); // add pointer to watch list
+  watch_tracker(&wp_); // add pointer to watch list
 }
 
 /**
@@ -2257,7 +2585,7 @@ Fl_Widget_Tracker::Fl_Widget_Tracker(Fl_Widget *wi)
 */
 Fl_Widget_Tracker::~Fl_Widget_Tracker()
 {
-  Fl::release_widget_pointer(wp_); // remove pointer from watch list
+  release_tracker(&wp_); // remove pointer from watch list
 }
 
 int Fl::use_high_res_GL_ = 0;
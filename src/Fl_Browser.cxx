@@ -20,6 +20,8 @@
 #include <FL/Fl_Browser.H>
 #include <FL/fl_draw.H>
 #include "flstring.h"
+#include "Fl_Browser_Line.H"
+#include "Fl_Treap.H"
 #include <stdlib.h>
 #include <math.h>
 
@@ -30,31 +32,411 @@
 
 // I modified this from the original Forms data to use a linked list
 // so that the number of items in the browser and size of those items
-// is unlimited. The only problem is that the old browser used an
-// index number to identify a line, and it is slow to convert from/to
-// a pointer. I use a cache of the last match to try to speed this up.
+// is unlimited. The old browser used an index number to identify a
+// line, so the lines are also kept in a tree that converts from/to a
+// pointer in O(log n), see Fl_Browser_Line.H and Fl_Treap.H. The tree also sums the
+// heights of the lines, to find the line at a scroll position. The root
+// of the tree is found from the first line. A cache of the last match
+// makes walking the lines by number O(1).
 
 // Also added the ability to "hide" a line. This sets its height to
 // zero, so the Fl_Browser_ cannot pick it.
 
-#define SELECTED 1
-#define NOTDISPLAYED 2
+static int total(const FL_BLINE* l) {return l ? l->total : 0;}
 
-// WARNING:
-//       Fl_File_Chooser.cxx also has a definition of this structure (FL_BLINE).
-//       Changes to FL_BLINE *must* be reflected in Fl_File_Chooser.cxx as well.
-//       This hack in Fl_File_Chooser should be solved.
-//
-struct FL_BLINE {	// data is in a linked list of these
-  FL_BLINE* prev;
-  FL_BLINE* next;
+struct FL_BLINE_Sums {
+  static void update(FL_BLINE* l) {
+    l->count = 1 + (l->left ? l->left->count : 0) + (l->right ? l->right->count : 0);
+    l->total = l->height + total(l->left) + total(l->right);
+  }
+};
+
+typedef Fl_Treap<FL_BLINE, FL_BLINE_Sums> Tree;
+
+// Adds n lines of height h to the counts of l and all its parents:
+static void add_count(FL_BLINE* l, int n, int h) {
+  for (; l; l = l->parent) {l->count += n; l->total += h;}
+}
+
+// Changes the height of a line, returns the difference:
+static int set_height(FL_BLINE* l, int h) {
+  int d = h - l->height;
+  l->height = h;
+  if (d) add_count(l, 0, d);
+  return d;
+}
+
+// Sums the heights of all lines again:
+static int update_totals(FL_BLINE* l) {
+  if (!l) return 0;
+  l->total = l->height + update_totals(l->left) + update_totals(l->right);
+  return l->total;
+}
+
+// Returns the sum of the heights of the lines before l:
+static int line_position(const FL_BLINE* l) {
+  int y = total(l->left);
+  for (; l->parent; l = l->parent)
+    if (l->parent->right == l) y += total(l->parent->left) + l->parent->height;
+  return y;
+}
+
+// Puts item into the list and the tree before n, or at the end:
+static void link_line(FL_BLINE* item, FL_BLINE* n, FL_BLINE*& first, FL_BLINE*& last) {
+  Tree::insert(item, n, last);	// item->height is set already
+  item->next = n;
+  item->prev = n ? n->prev : last;
+  if (item->prev) item->prev->next = item; else first = item;
+  if (n) n->prev = item; else last = item;
+}
+
+static void unlink_line(FL_BLINE* item, FL_BLINE*& first, FL_BLINE*& last) {
+  Tree::remove(item);
+  if (item->prev) item->prev->next = item->next; else first = item->next;
+  if (item->next) item->next->prev = item->prev; else last = item->prev;
+}
+
+// Parses the format codes at the start of each column of line l, with
+// the format code prefix fc and the column separator cc:
+static void parse_line(FL_BLINE* l, char fc, char cc) {
+  free(l->fields);
+  l->fields = 0;
+  l->width = -1;
+  if ((!fc || !strchr(l->txt, fc)) && (!cc || !strchr(l->txt, cc))) return;
+  int n = 1;
+  char* str;
+  if (cc) for (str = strchr(l->txt, cc); str; str = strchr(str + 1, cc)) n++;
+  l->fields = (FL_BFIELD*)malloc(n * sizeof(FL_BFIELD));
+  str = l->txt;
+  for (int k = 0; k < n; k++) {
+    FL_BFIELD* f = l->fields + k;
+    f->font = -1;
+    f->size = -1;
+    f->color = f->background = f->underline = 0;
+    f->bits = 0;
+    f->align = FL_ALIGN_LEFT;
+    f->flags = 0;
+    char* e = cc ? strchr(str, cc) : 0; // end the column for strtol()
+    if (e) *e = 0;
+    // check for all the @-lines recognized by XForms:
+    while (fc && *str == fc && *++str && *str != fc) {
+      switch (*str++) {
+      case 'l': case 'L': f->size = 24; break;
+      case 'm': case 'M': f->size = 18; break;
+      case 's': f->size = 11; break;
+      case 'b': f->bits |= FL_BOLD; break;
+      case 'i': f->bits |= FL_ITALIC; break;
+      case 'f': case 't': f->font = FL_COURIER; f->bits = 0; break;
+      case 'c': f->align = FL_ALIGN_CENTER; break;
+      case 'r': f->align = FL_ALIGN_RIGHT; break;
+      case 'B':
+	f->background = (Fl_Color)strtol(str, &str, 10);
+	f->flags |= FIELD_BACKGROUND;
+	break;
+      case 'C':
+	f->color = (Fl_Color)strtol(str, &str, 10);
+	f->flags |= FIELD_COLOR;
+	break;
+      case 'F':
+	f->font = (Fl_Font)strtol(str, &str, 10);
+	f->bits = 0;
+	break;
+      case 'N':
+	f->color = FL_INACTIVE_COLOR;
+	f->flags |= FIELD_COLOR;
+	break;
+      case 'S':
+	f->size = strtol(str, &str, 10);
+	break;
+      case '-':
+	f->flags |= FIELD_ENGRAVED;
+	break;
+      case 'u':
+      case '_':
+	// the underline is in the color set so far:
+	f->flags |= FIELD_UNDERLINE;
+	if (f->flags & FIELD_COLOR) {f->underline = f->color; f->flags |= FIELD_UCOLOR;}
+	else f->flags &= ~FIELD_UCOLOR;
+	break;
+      case '.':
+	goto BREAK;
+      case '@':
+	str--; goto BREAK;
+      }
+    }
+  BREAK:
+    f->start = (int)(str - l->txt);
+    if (!e) {
+      f->end = f->start + (int) strlen(str);
+      break;
+    }
+    *e = cc;
+    f->end = (int)(e - l->txt);
+    str = e + 1;
+  }
+}
+
+// The lines added by add_bulk() are allocated together in blocks. Each
+// line in a block is preceded by a pointer to the block, which counts
+// its lines and is freed when the last of them is freed.
+
+struct Fl_Browser_Slab {
+  int lines;		// lines in the block that were not freed yet
+};
+
+// Returns the room a line of length l takes in a block:
+static size_t slab_size(int l) {
+  return (sizeof(Fl_Browser_Slab*) + sizeof(FL_BLINE) + l + 7) & ~(size_t)7;
+}
+
+// Allocates a block of size bytes for n lines:
+static Fl_Browser_Slab* new_slab(size_t size, int n) {
+  Fl_Browser_Slab* s = (Fl_Browser_Slab*)malloc(sizeof(double) + size);
+  s->lines = n;
+  return s;
+}
+
+// Returns the memory for the lines of a block:
+static char* slab_lines(Fl_Browser_Slab* s) {return (char*)s + sizeof(double);}
+
+// Returns the block of a line allocated by add_bulk():
+static Fl_Browser_Slab* line_slab(FL_BLINE* t) {return ((Fl_Browser_Slab**)t)[-1];}
+
+// Makes a line of block b at p from the l characters at s:
+static FL_BLINE* slab_line(Fl_Browser_Slab* b, char* p, const char* s, int l, void* d) {
+  *(Fl_Browser_Slab**)p = b;
+  FL_BLINE* t = (FL_BLINE*)(p + sizeof(Fl_Browser_Slab*));
+  t->length = (short)l;
+  t->flags = SLAB;
+  memcpy(t->txt, s, l);
+  t->txt[l] = 0;
+  t->data = d;
+  t->icon = 0;
+  t->fields = 0;
+  return t;
+}
+
+static void free_line(FL_BLINE* l) {
+  free(l->fields);
+  if (!(l->flags & SLAB)) free(l);
+  else {
+    Fl_Browser_Slab* s = line_slab(l);
+    if (!--s->lines) free(s);
+  }
+}
+
+// In virtual mode (see virtual_rows()) the browser keeps no lines. The
+// items Fl_Browser_ deals with are the line numbers, and a line is only
+// put together from the callback when it is measured or drawn. The
+// selection is kept as a sorted list of ranges of lines.
+
+static void* row_item(int line) {return (void*)(fl_intptr_t)line;}
+static int row_line(void* item) {return (int)(fl_intptr_t)item;}
+
+struct Fl_Browser_Rows {
+  Fl_Browser* browser;
+  Fl_Browser_Rows* next;
+  Fl_Browser_Row_Cb* cb;
   void* data;
-  Fl_Image* icon;
-  short length;		// sizeof(txt)-1, may be longer than string
-  char flags;		// selected, displayed
-  char txt[1];		// start of allocated array
+  int row_height;	// height of all lines, 0 for a line of text, < 0 if
+			// each line has its own height
+  int* sums;		// if row_height < 0: Fenwick tree of the line heights
+  int nsums, asums;
+  int* ranges;		// first and last line of each selected range
+  int nranges, aranges;	// number of ranges, allocated ints
+  FL_BLINE* line;	// the last line put together
+  int aline;
+
+  void get(int n, Fl_Browser_Row& row) const;
+  FL_BLINE* materialize(int n);
+  int height(int n) const;
+  int position(int n) const;
+  int find(int pos, int& item_pos) const;
+  void resize(int n);
+  int range(int n) const;
+  int selected(int n) const;
+  void select(int n, int val);
+  void insert_range(int i);
+  void remove_range(int i);
 };
 
+static Fl_Browser_Rows* all_rows = 0;
+
+// Returns the state of the virtual mode, or NULL if not in virtual mode.
+// The state found is moved to the front of the list, so that the browser
+// being drawn or scrolled finds it at once:
+Fl_Browser_Rows* Fl_Browser::rows() const {
+  if (!all_rows) return 0;
+  if (all_rows->browser == this) return all_rows;
+  for (Fl_Browser_Rows** p = &all_rows->next; *p; p = &(*p)->next) {
+    Fl_Browser_Rows* r = *p;
+    if (r->browser != this) continue;
+    *p = r->next;
+    r->next = all_rows;
+    all_rows = r;
+    return r;
+  }
+  return 0;
+}
+
+// Asks the callback for line n:
+void Fl_Browser_Rows::get(int n, Fl_Browser_Row& row) const {
+  row.text = 0;
+  row.data = 0;
+  row.icon = 0;
+  fl_font(browser->textfont(), browser->textsize());
+  row.height = fl_height();
+  row.format_char = browser->format_char();
+  cb(n, &row, data);
+}
+
+// Puts line n together for measuring or drawing it:
+FL_BLINE* Fl_Browser_Rows::materialize(int n) {
+  Fl_Browser_Row row;
+  get(n, row);
+  const char* t = row.text ? row.text : "";
+  int l = (int) strlen(t);
+  if (!line || l > aline) {
+    if (line) free(line->fields);
+    free(line);
+    aline = l + 32;
+    line = (FL_BLINE*)malloc(sizeof(FL_BLINE) + aline);
+    line->fields = 0;
+  }
+  strcpy(line->txt, t);
+  line->length = (short)l;
+  line->data = row.data;
+  line->icon = row.icon;
+  line->flags = 0;
+  if (selected(n)) line->flags |= SELECTED;
+  if (!height(n)) line->flags |= NOTDISPLAYED;
+  parse_line(line, row.format_char, browser->column_char());
+  return line;
+}
+
+int Fl_Browser_Rows::height(int n) const {
+  if (row_height > 0) return row_height;
+  if (row_height == 0) {
+    fl_font(browser->textfont(), browser->textsize());
+    return fl_height();
+  }
+  return position(n + 1) - position(n);
+}
+
+// Returns the sum of the heights of the lines before line n:
+int Fl_Browser_Rows::position(int n) const {
+  if (row_height >= 0) return (n - 1) * height(1);
+  int y = 0;
+  for (n--; n > 0; n -= n & -n) y += sums[n];
+  return y;
+}
+
+// Returns the line at vertical position pos, and its position in item_pos:
+int Fl_Browser_Rows::find(int pos, int& item_pos) const {
+  int n = browser->size();
+  if (row_height >= 0) {
+    int h = height(1);
+    int i = pos / h;
+    if (i >= n) i = n - 1;
+    item_pos = i * h;
+    return i + 1;
+  }
+  int i = 0, y = 0, m = 1;
+  while (m * 2 <= n) m *= 2;
+  for (; m; m /= 2)
+    if (i + m <= n && y + sums[i + m] <= pos) {i += m; y += sums[i];}
+  if (i >= n) return n ? find(y - 1, item_pos) : 0;
+  item_pos = y;
+  return i + 1;
+}
+
+// Changes the number of lines, asks the callback for the heights of the
+// new lines if needed and drops the selection past the end:
+void Fl_Browser_Rows::resize(int n) {
+  if (row_height < 0) {
+    if (n + 1 > asums) {
+      asums = n + 1 + (n + 1) / 2;
+      sums = (int*)realloc(sums, asums * sizeof(int));
+    }
+    for (int i = nsums + 1; i <= n; i++) {
+      Fl_Browser_Row row;
+      get(i, row);
+      // the sum of the lines (i - (i & -i), i] from the sums before i:
+      sums[i] = row.height + position(i) - position(i - (i & -i) + 1);
+    }
+    nsums = n;
+  }
+  while (nranges && ranges[2 * nranges - 2] > n) nranges--;
+  if (nranges && ranges[2 * nranges - 1] > n) ranges[2 * nranges - 1] = n;
+}
+
+// Returns the index of the last range that starts at or before line n, or -1:
+int Fl_Browser_Rows::range(int n) const {
+  int a = 0, b = nranges;
+  while (a < b) {
+    int c = (a + b) / 2;
+    if (ranges[2 * c] <= n) a = c + 1; else b = c;
+  }
+  return a - 1;
+}
+
+int Fl_Browser_Rows::selected(int n) const {
+  int i = range(n);
+  return i >= 0 && n <= ranges[2 * i + 1];
+}
+
+// Makes room for a new range at index i:
+void Fl_Browser_Rows::insert_range(int i) {
+  if (2 * nranges + 2 > aranges) {
+    aranges = aranges ? 2 * aranges : 16;
+    ranges = (int*)realloc(ranges, aranges * sizeof(int));
+  }
+  memmove(ranges + 2 * i + 2, ranges + 2 * i, (nranges - i) * 2 * sizeof(int));
+  nranges++;
+}
+
+void Fl_Browser_Rows::remove_range(int i) {
+  memmove(ranges + 2 * i, ranges + 2 * i + 2, (nranges - i - 1) * 2 * sizeof(int));
+  nranges--;
+}
+
+void Fl_Browser_Rows::select(int n, int val) {
+  int i = range(n);
+  int in = i >= 0 && n <= ranges[2 * i + 1];
+  if (val) {
+    if (in) return;
+    int prev = i >= 0 && ranges[2 * i + 1] == n - 1;
+    int next = i + 1 < nranges && ranges[2 * i + 2] == n + 1;
+    if (prev && next) {		// join the two ranges
+      ranges[2 * i + 1] = ranges[2 * i + 3];
+      remove_range(i + 1);
+    } else if (prev) {
+      ranges[2 * i + 1] = n;
+    } else if (next) {
+      ranges[2 * i + 2] = n;
+    } else {
+      insert_range(i + 1);
+      ranges[2 * i + 2] = ranges[2 * i + 3] = n;
+    }
+  } else {
+    if (!in) return;
+    int* r = ranges + 2 * i;
+    if (r[0] == r[1]) {
+      remove_range(i);
+    } else if (n == r[0]) {
+      r[0]++;
+    } else if (n == r[1]) {
+      r[1]--;
+    } else {			// split the range
+      insert_range(i + 1);
+      r = ranges + 2 * i;
+      r[3] = r[1];
+      r[2] = n + 1;
+      r[1] = n - 1;
+    }
+  }
+}
+
 /**
   Returns the very first item in the list.
   Example of use:
@@ -67,7 +449,10 @@ struct FL_BLINE {	// data is in a linked list of these
   \returns The first item, or NULL if list is empty.
   \see item_first(), item_last(), item_next(), item_prev()
 */
-void* Fl_Browser::item_first() const {return first;}
+void* Fl_Browser::item_first() const {
+  if (rows()) return lines ? row_item(1) : 0;
+  return first;
+}
 
 /**
   Returns the next item after \p item.
@@ -75,7 +460,10 @@ void* Fl_Browser::item_first() const {return first;}
   \returns The next item after \p item, or NULL if there are none after this one.
   \see item_first(), item_last(), item_next(), item_prev()
 */
-void* Fl_Browser::item_next(void* item) const {return ((FL_BLINE*)item)->next;}
+void* Fl_Browser::item_next(void* item) const {
+  if (rows()) return row_line(item) < lines ? row_item(row_line(item) + 1) : 0;
+  return ((FL_BLINE*)item)->next;
+}
 
 /**
   Returns the previous item before \p item.
@@ -83,7 +471,10 @@ void* Fl_Browser::item_next(void* item) const {return ((FL_BLINE*)item)->next;}
   \returns The previous item before \p item, or NULL if there are none before this one.
   \see item_first(), item_last(), item_next(), item_prev()
 */
-void* Fl_Browser::item_prev(void* item) const {return ((FL_BLINE*)item)->prev;}
+void* Fl_Browser::item_prev(void* item) const {
+  if (rows()) return row_item(row_line(item) - 1);
+  return ((FL_BLINE*)item)->prev;
+}
 
 /**
   Returns the very last item in the list.
@@ -97,7 +488,10 @@ void* Fl_Browser::item_prev(void* item) const {return ((FL_BLINE*)item)->prev;}
   \returns The last item, or NULL if list is empty.
   \see item_first(), item_last(), item_next(), item_prev()
 */
-void* Fl_Browser::item_last() const {return last;}
+void* Fl_Browser::item_last() const {
+  if (rows()) return row_item(lines);
+  return last;
+}
 
 /**
   See if \p item is selected.
@@ -106,6 +500,7 @@ void* Fl_Browser::item_last() const {return last;}
   \see select(), selected(), value(), item_select(), item_selected()
 */
 int Fl_Browser::item_selected(void* item) const {
+  if (rows()) return rows()->selected(row_line(item));
   return ((FL_BLINE*)item)->flags&SELECTED;
 }
 /**
@@ -115,7 +510,8 @@ int Fl_Browser::item_selected(void* item) const {
   \see select(), selected(), value(), item_select(), item_selected()
 */
 void Fl_Browser::item_select(void *item, int val) {
-  if (val) ((FL_BLINE*)item)->flags |= SELECTED;
+  if (rows()) rows()->select(row_line(item), val);
+  else if (val) ((FL_BLINE*)item)->flags |= SELECTED;
   else     ((FL_BLINE*)item)->flags &= ~SELECTED;
 }
 
@@ -125,19 +521,20 @@ void Fl_Browser::item_select(void *item, int val) {
   \returns The item's text string. (Can be NULL)
 */
 const char *Fl_Browser::item_text(void *item) const { 
+  if (rows()) return text(row_line(item));
   return ((FL_BLINE*)item)->txt;
 }
 
 /**
   Returns the item for specified \p line.
 
-  Note: This call is slow. It's fine for e.g. responding to user
-  clicks, but slow if called often, such as in a tight sorting loop.
-  Finding an item 'by line' involves a linear lookup on the internal
-  linked list. The performance hit can be significant if the browser's
-  contents is large, and the method is called often (e.g. during a sort).
-  If you're writing a subclass, use the protected methods item_first(),
-  item_next(), etc. to access the internal linked list more efficiently.
+  Note: Finding an item 'by line' takes O(log n) time, or constant
+  time for the line before or after the one found last. If you're
+  writing a subclass, use the protected methods item_first(),
+  item_next(), etc. to walk the internal linked list.
+
+  In virtual mode the browser has no lines, and this returns \p line
+  itself cast to a pointer, which is the item Fl_Browser_ deals with.
 
   \param[in] line The line number of the item to return. (1 based)
   \retval item that was found.
@@ -145,25 +542,73 @@ const char *Fl_Browser::item_text(void *item) const {
   \see item_at(), find_line(), lineno()
 */
 FL_BLINE* Fl_Browser::find_line(int line) const {
-  int n; FL_BLINE* l;
-  if (line == cacheline) return cache;
-  if (cacheline && line > (cacheline/2) && line < ((cacheline+lines)/2)) {
-    n = cacheline; l = cache;
-  } else if (line <= (lines/2)) {
-    n = 1; l = first;
-  } else {
-    n = lines; l = last;
+  if (line < 1 || line > lines) return 0;
+  if (rows()) return (FL_BLINE*)row_item(line);
+  if (cache) {
+    if (line == cacheline) return cache;
+    // walking the lines one by one is common:
+    if (line == cacheline + 1 || line == cacheline - 1) {
+      FL_BLINE* l = line > cacheline ? cache->next : cache->prev;
+      ((Fl_Browser*)this)->cacheline = line;
+      ((Fl_Browser*)this)->cache = l;
+      return l;
+    }
   }
-  for (; n < line && l; n++) l = l->next;
-  for (; n > line && l; n--) l = l->prev;
+  FL_BLINE* l = Tree::find(Tree::root(first), line);
   ((Fl_Browser*)this)->cacheline = line;
   ((Fl_Browser*)this)->cache = l;
   return l;
 }
 
+#if FLTK_ABI_VERSION >= 10304 || defined(FL_DOXYGEN)
+
+/**
+  Returns the line that contains the vertical position \p pos, and its
+  position in \p item_pos. This takes O(log n) time.
+  \note Availability in FLTK_ABI_VERSION 10304 or higher.
+  \see Fl_Browser_::item_at_position()
+*/
+void *Fl_Browser::item_at_position(int pos, int &item_pos) const {
+  if (rows()) {
+    if (full_height() <= 0) return 0;
+    if (pos < 0) pos = 0;
+    return row_item(rows()->find(pos, item_pos));
+  }
+  FL_BLINE* l = Tree::root(first);
+  if (!l || l->total <= 0) return 0;
+  if (pos >= l->total) pos = l->total - 1;
+  if (pos < 0) pos = 0;
+  item_pos = 0;
+  for (;;) {
+    int t = total(l->left);
+    if (pos < t) l = l->left;
+    else if (pos < t + l->height) {item_pos += t; break;}
+    else {
+      pos -= t + l->height;
+      item_pos += t + l->height;
+      l = l->right;
+    }
+  }
+  return l;
+}
+
+/**
+  Returns the vertical position of \p item, the sum of the heights of
+  the lines before it. This takes O(log n) time.
+  \note Availability in FLTK_ABI_VERSION 10304 or higher.
+  \see Fl_Browser_::item_position()
+*/
+int Fl_Browser::item_position(void *item) const {
+  if (!item) return -1;
+  if (rows()) return rows()->position(row_line(item));
+  return line_position((FL_BLINE*)item);
+}
+
+#endif
+
 /**
   Returns line number corresponding to \p item, or zero if not found.
-  Caveat: See efficiency note in find_line().
+  Caveat: Takes O(log n) time, see find_line().
   \param[in] item The item to be found
   \returns The line number of the item, or 0 if not found.
   \see item_at(), find_line(), lineno()
@@ -171,25 +616,11 @@ FL_BLINE* Fl_Browser::find_line(int line) const {
 int Fl_Browser::lineno(void *item) const {
   FL_BLINE* l = (FL_BLINE*)item;
   if (!l) return 0;
+  if (rows()) return row_line(item);
   if (l == cache) return cacheline;
   if (l == first) return 1;
   if (l == last) return lines;
-  if (!cache) {
-    ((Fl_Browser*)this)->cache = first;
-    ((Fl_Browser*)this)->cacheline = 1;
-  }
-  // assume it is near cache, search both directions:
-  FL_BLINE* b = cache->prev;
-  int bnum = cacheline-1;
-  FL_BLINE* f = cache->next;
-  int fnum = cacheline+1;
-  int n = 0;
-  for (;;) {
-    if (b == l) {n = bnum; break;}
-    if (f == l) {n = fnum; break;}
-    if (b) {b = b->prev; bnum--;}
-    if (f) {f = f->next; fnum++;}
-  }
+  int n = Tree::index(l);
   ((Fl_Browser*)this)->cache = l;
   ((Fl_Browser*)this)->cacheline = n;
   return n;
@@ -197,7 +628,7 @@ int Fl_Browser::lineno(void *item) const {
 
 /**
   Removes the item at the specified \p line.
-  Caveat: See efficiency note in find_line().
+  Caveat: Takes O(log n) time, see find_line().
   You must call redraw() to make any changes visible.
   \param[in] line The line number to be removed. (1 based) Must be in range!
   \returns Pointer to browser item that was removed (and is no longer valid).
@@ -210,11 +641,8 @@ FL_BLINE* Fl_Browser::_remove(int line) {
   cacheline = line-1;
   cache = ttt->prev;
   lines--;
-  full_height_ -= item_height(ttt);
-  if (ttt->prev) ttt->prev->next = ttt->next;
-  else first = ttt->next;
-  if (ttt->next) ttt->next->prev = ttt->prev;
-  else last = ttt->prev;
+  full_height_ -= ttt->height;
+  unlink_line(ttt, first, last);
 
   return(ttt);
 }
@@ -227,46 +655,30 @@ FL_BLINE* Fl_Browser::_remove(int line) {
   \see add(), insert(), remove(), swap(int,int), clear()
 */
 void Fl_Browser::remove(int line) {
-  if (line < 1 || line > lines) return;
-  free(_remove(line));
+  if (line < 1 || line > lines || rows()) return;
+  free_line(_remove(line));
 }
 
 /**
   Insert specified \p item above \p line.
   If \p line > size() then the line is added to the end.
 
-  Caveat: See efficiency note in find_line().
+  Caveat: Takes O(log n) time, see find_line().
 
   \param[in] line  The new line will be inserted above this line (1 based).
   \param[in] item  The item to be added.
 */
 void Fl_Browser::insert(int line, FL_BLINE* item) {
-  if (!first) {
-    item->prev = item->next = 0;
-    first = last = item;
-  } else if (line <= 1) {
-    inserting(first, item);
-    item->prev = 0;
-    item->next = first;
-    item->next->prev = item;
-    first = item;
-  } else if (line > lines) {
-    item->prev = last;
-    item->prev->next = item;
-    item->next = 0;
-    last = item;
-  } else {
-    FL_BLINE* n = find_line(line);
-    inserting(n, item);
-    item->next = n;
-    item->prev = n->prev;
-    item->prev->next = item;
-    n->prev = item;
-  }
+  if (line < 1) line = 1;
+  if (line > lines) line = lines + 1;
+  FL_BLINE* n = (line <= lines) ? find_line(line) : 0;
+  if (n) inserting(n, item);
+  item->height = item_height(item);
+  link_line(item, n, first, last);
   cacheline = line;
   cache = item;
   lines++;
-  full_height_ += item_height(item);
+  full_height_ += item->height;
   redraw_line(item);
 }
 
@@ -284,6 +696,7 @@ void Fl_Browser::insert(int line, FL_BLINE* item) {
   \param[in] d Optional pointer to user data to be associated with the new line.
 */
 void Fl_Browser::insert(int line, const char* newtext, void* d) {
+  if (rows()) return;
   if (!newtext) newtext = "";		// STR #3269
   int l = (int) strlen(newtext);
   FL_BLINE* t = (FL_BLINE*)malloc(sizeof(FL_BLINE)+l);
@@ -292,6 +705,8 @@ void Fl_Browser::insert(int line, const char* newtext, void* d) {
   strcpy(t->txt, newtext);
   t->data = d;
   t->icon = 0;
+  t->fields = 0;
+  parse_line(t, format_char_, column_char_);
   insert(line, t);
 }
 
@@ -302,7 +717,7 @@ void Fl_Browser::insert(int line, const char* newtext, void* d) {
   \param[in] from Line number of item to be moved
 */
 void Fl_Browser::move(int to, int from) {
-  if (from < 1 || from > lines) return;
+  if (from < 1 || from > lines || rows()) return;
   insert(to, _remove(from));
 }
 
@@ -318,7 +733,7 @@ void Fl_Browser::move(int to, int from) {
   \param[in] newtext The new string to be assigned to the item.
 */
 void Fl_Browser::text(int line, const char* newtext) {
-  if (line < 1 || line > lines) return;
+  if (line < 1 || line > lines || rows()) return;
   FL_BLINE* t = find_line(line);
   if (!newtext) newtext = "";		// STR #3269
   int l = (int) strlen(newtext);
@@ -328,16 +743,30 @@ void Fl_Browser::text(int line, const char* newtext) {
     cache = n;
     n->data = t->data;
     n->icon = t->icon;
+    n->fields = 0;
     n->length = (short)l;
-    n->flags = t->flags;
+    n->flags = t->flags & ~SLAB;
     n->prev = t->prev;
     if (n->prev) n->prev->next = n; else first = n;
     n->next = t->next;
     if (n->next) n->next->prev = n; else last = n;
-    free(t);
+    // n takes the place of t in the tree:
+    n->parent = t->parent;
+    n->left = t->left;
+    n->right = t->right;
+    n->count = t->count;
+    n->total = t->total;
+    n->height = t->height;
+    n->priority = t->priority;
+    Tree::replace_child(n->parent, t, n);
+    if (n->left) n->left->parent = n;
+    if (n->right) n->right->parent = n;
+    free_line(t);
     t = n;
   }
   strcpy(t->txt, newtext);
+  parse_line(t, format_char_, column_char_);
+  full_height_ += set_height(t, item_height(t));
   redraw_line(t);
 }
 
@@ -348,61 +777,56 @@ void Fl_Browser::text(int line, const char* newtext) {
   \param[in] d The new data to be assigned to the item. (can be NULL)
 */
 void Fl_Browser::data(int line, void* d) {
-  if (line < 1 || line > lines) return;
+  if (line < 1 || line > lines || rows()) return;
   find_line(line)->data = d;
 }
 
-/**
-  Returns height of \p item in pixels.
-  This takes into account embedded \@ codes within the text() label.
-  \param[in] item The item whose height is returned.
-  \returns The height of the item in pixels.
-  \see item_height(), item_width(),\n
-       incr_height(), full_height()
-*/
-int Fl_Browser::item_height(void *item) const {
-  FL_BLINE* l = (FL_BLINE*)item;
+// Returns the columns of line l, using plain for a line without any:
+static FL_BFIELD* line_fields(FL_BLINE* l, FL_BFIELD& plain) {
+  if (l->fields) return l->fields;
+  plain.start = 0;
+  plain.end = (int) strlen(l->txt);
+  plain.font = -1;
+  plain.size = -1;
+  plain.bits = 0;
+  plain.align = FL_ALIGN_LEFT;
+  plain.flags = 0;
+  return &plain;
+}
+
+static Fl_Font field_font(const Fl_Browser* b, const FL_BFIELD* f) {
+  return (Fl_Font)((f->font < 0 ? b->textfont() : f->font) | f->bits);
+}
+
+static Fl_Fontsize field_size(const Fl_Browser* b, const FL_BFIELD* f) {
+  return f->size < 0 ? b->textsize() : f->size;
+}
+
+// Returns the height of line l:
+static int line_height(const Fl_Browser* b, FL_BLINE* l) {
   if (l->flags & NOTDISPLAYED) return 0;
 
   int hmax = 2; // use 2 to insure we don't return a zero!
 
   if (!l->txt[0]) {
     // For blank lines set the height to exactly 1 line!
-    fl_font(textfont(), textsize());
+    fl_font(b->textfont(), b->textsize());
     int hh = fl_height();
     if (hh > hmax) hmax = hh;
   } else {
-    const int* i = column_widths();
+    FL_BFIELD plain;
+    const int* i = b->column_widths();
     // do each column separately as they may all set different fonts:
-    for (char* str = l->txt; str && *str; str++) {
-      Fl_Font font = textfont(); // default font
-      int tsize = textsize(); // default size
-      while (*str==format_char()) {
-	str++;
-	switch (*str++) {
-	case 'l': case 'L': tsize = 24; break;
-	case 'm': case 'M': tsize = 18; break;
-	case 's': tsize = 11; break;
-	case 'b': font = (Fl_Font)(font|FL_BOLD); break;
-	case 'i': font = (Fl_Font)(font|FL_ITALIC); break;
-	case 'f': case 't': font = FL_COURIER; break;
-	case 'B':
-	case 'C': while (isdigit(*str & 255)) str++; break; // skip a color number
-	case 'F': font = (Fl_Font)strtol(str,&str,10); break;
-	case 'S': tsize = strtol(str,&str,10); break;
-	case 0: case '@': str--;
-	case '.': goto END_FORMAT;
-	}
-      }
-      END_FORMAT:
-      char* ptr = str;
-      if (ptr && *i++) str = strchr(str, column_char());
-      else str = NULL;
-      if((!str && *ptr) || (str && ptr < str)) {
-	fl_font(font, tsize); int hh = fl_height();
+    for (FL_BFIELD* f = line_fields(l, plain); ; f++) {
+      // after the last column the rest of the line is one column:
+      int last = !*i || !l->txt[f->end];
+      if (last ? l->txt[f->start] : f->start < f->end) {
+	fl_font(field_font(b, f), field_size(b, f));
+	int hh = fl_height();
 	if (hh > hmax) hmax = hh;
       }
-      if (!str || !*str) break;
+      if (last) break;
+      i++;
     }
   }
 
@@ -413,64 +837,56 @@ int Fl_Browser::item_height(void *item) const {
 }
 
 /**
-  Returns width of \p item in pixels.
+  Returns height of \p item in pixels.
   This takes into account embedded \@ codes within the text() label.
-  \param[in] item The item whose width is returned.
-  \returns The width of the item in pixels.
+  \param[in] item The item whose height is returned.
+  \returns The height of the item in pixels.
   \see item_height(), item_width(),\n
        incr_height(), full_height()
 */
-int Fl_Browser::item_width(void *item) const {
-  FL_BLINE* l=(FL_BLINE*)item;
-  char* str = l->txt;
-  const int* i = column_widths();
-  int ww = 0;
-
-  while (*i) { // add up all tab-separated fields
-    char* e;
-    e = strchr(str, column_char());
-    if (!e) break; // last one occupied by text
-    str = e+1;
-    ww += *i++;
-  }
+int Fl_Browser::item_height(void *item) const {
+  Fl_Browser_Rows* r = rows();
+  if (r) return r->height(row_line(item));
+  return line_height(this, (FL_BLINE*)item);
+}
 
-  // OK, we gotta parse the string and find the string width...
-  int tsize = textsize();
-  Fl_Font font = textfont();
-  int done = 0;
-
-  while (*str == format_char_ && str[1] && str[1] != format_char_) {
-    str ++;
-    switch (*str++) {
-    case 'l': case 'L': tsize = 24; break;
-    case 'm': case 'M': tsize = 18; break;
-    case 's': tsize = 11; break;
-    case 'b': font = (Fl_Font)(font|FL_BOLD); break;
-    case 'i': font = (Fl_Font)(font|FL_ITALIC); break;
-    case 'f': case 't': font = FL_COURIER; break;
-    case 'B':
-    case 'C': while (isdigit(*str & 255)) str++; break; // skip a color number
-    case 'F': font = (Fl_Font)strtol(str, &str, 10); break;
-    case 'S': tsize = strtol(str, &str, 10); break;
-    case '.':
-      done = 1;
-      break;
-    case '@':
-      str--;
-      done = 1;
-    }
+// Returns the width of line l, the text of the last column is measured
+// only if it was not before:
+static int line_width(const Fl_Browser* b, FL_BLINE* l) {
+  FL_BFIELD plain;
+  FL_BFIELD* f = line_fields(l, plain);
+  const int* i = b->column_widths();
+  int k = 0, ww = 0;
 
-    if (done)
-      break;
+  while (*i && l->txt[f->end]) { // add up all tab-separated fields
+    ww += *i++;
+    f++;
+    k++;
   }
 
-  if (*str == format_char_ && str[1])
-    str ++;
+  if (l->width < 0 || l->wfield != k) {
+    fl_font(field_font(b, f), field_size(b, f));
+    l->width = int(fl_width(l->txt + f->start));
+    l->wfield = k;
+  }
 
   if (ww==0 && l->icon) ww = l->icon->w();
 
-  fl_font(font, tsize);
-  return ww + int(fl_width(str)) + 6;
+  return ww + l->width + 6;
+}
+
+/**
+  Returns width of \p item in pixels.
+  This takes into account embedded \@ codes within the text() label.
+  \param[in] item The item whose width is returned.
+  \returns The width of the item in pixels.
+  \see item_height(), item_width(),\n
+       incr_height(), full_height()
+*/
+int Fl_Browser::item_width(void *item) const {
+  Fl_Browser_Rows* r = rows();
+  if (r) return line_width(this, r->materialize(row_line(item)));
+  return line_width(this, (FL_BLINE*)item);
 }
 
 /**
@@ -482,6 +898,8 @@ int Fl_Browser::item_width(void *item) const {
        incr_height(), full_height()
 */
 int Fl_Browser::full_height() const {
+  Fl_Browser_Rows* r = rows();
+  if (r) return r->position(lines + 1);
   return full_height_;
 }
 
@@ -496,26 +914,18 @@ int Fl_Browser::incr_height() const {
   return textsize()+2;
 }
 
-/**
-  Draws \p item at the position specified by \p X \p Y \p W \p H.
-  The \p W and \p H values are used for clipping.
-  Should only be called within the context of an FLTK draw().
-  \param[in] item The item to be drawn
-  \param[in] X,Y,W,H position and size.
-*/
-void Fl_Browser::item_draw(void* item, int X, int Y, int W, int H) const {
-  FL_BLINE* l = (FL_BLINE*)item;
-  char* str = l->txt;
-  const int* i = column_widths();
+// Draws line l:
+static void draw_line(const Fl_Browser* b, FL_BLINE* l, int X, int Y, int W, int H) {
+  FL_BFIELD plain;
+  FL_BFIELD* f = line_fields(l, plain);
+  const int* i = b->column_widths();
 
   bool first = true;	// for icon
   while (W > 6) {	// do each tab-separated field
     int w1 = W;	// width for this field
-    char* e = 0; // pointer to end of field or null if none
-    if (*i) { // find end of field and temporarily replace with 0
-      e = strchr(str, column_char());
-      if (e) {*e = 0; w1 = *i++;}
-    }
+    // after the last column the rest of the line is one field:
+    int last = !*i || !l->txt[f->end];
+    if (!last) w1 = *i++;
     // Icon drawing code
     if (first) {
       first = false;
@@ -525,74 +935,55 @@ void Fl_Browser::item_draw(void* item, int X, int Y, int W, int H) const {
 	X += iconw; W -= iconw; w1 -= iconw;
       }
     }
-    int tsize = textsize();
-    Fl_Font font = textfont();
-    Fl_Color lcol = textcolor();
-    Fl_Align talign = FL_ALIGN_LEFT;
-    // check for all the @-lines recognized by XForms:
-    //#if defined(__GNUC__)
-    //#warning FIXME This maybe needs to be more UTF8 aware now...?
-    //#endif /*__GNUC__*/
-    while (*str == format_char() && *++str && *str != format_char()) {
-      switch (*str++) {
-      case 'l': case 'L': tsize = 24; break;
-      case 'm': case 'M': tsize = 18; break;
-      case 's': tsize = 11; break;
-      case 'b': font = (Fl_Font)(font|FL_BOLD); break;
-      case 'i': font = (Fl_Font)(font|FL_ITALIC); break;
-      case 'f': case 't': font = FL_COURIER; break;
-      case 'c': talign = FL_ALIGN_CENTER; break;
-      case 'r': talign = FL_ALIGN_RIGHT; break;
-      case 'B': 
-	if (!(l->flags & SELECTED)) {
-	  fl_color((Fl_Color)strtol(str, &str, 10));
-	  fl_rectf(X, Y, w1, H);
-	} else while (isdigit(*str & 255)) str++; // skip digits
-        break;
-      case 'C':
-	lcol = (Fl_Color)strtol(str, &str, 10);
-	break;
-      case 'F':
-	font = (Fl_Font)strtol(str, &str, 10);
-	break;
-      case 'N':
-	lcol = FL_INACTIVE_COLOR;
-	break;
-      case 'S':
-	tsize = strtol(str, &str, 10);
-	break;
-      case '-':
-	fl_color(FL_DARK3);
-	fl_line(X+3, Y+H/2, X+w1-3, Y+H/2);
-	fl_color(FL_LIGHT3);
-	fl_line(X+3, Y+H/2+1, X+w1-3, Y+H/2+1);
-	break;
-      case 'u':
-      case '_':
-	fl_color(lcol);
-	fl_line(X+3, Y+H-1, X+w1-3, Y+H-1);
-	break;
-      case '.':
-	goto BREAK;
-      case '@':
-	str--; goto BREAK;
-      }
+    Fl_Color lcol = (f->flags & FIELD_COLOR) ? f->color : b->textcolor();
+    if ((f->flags & FIELD_BACKGROUND) && !(l->flags & SELECTED)) {
+      fl_color(f->background);
+      fl_rectf(X, Y, w1, H);
     }
-  BREAK:
-    fl_font(font, tsize);
+    if (f->flags & FIELD_ENGRAVED) {
+      fl_color(FL_DARK3);
+      fl_line(X+3, Y+H/2, X+w1-3, Y+H/2);
+      fl_color(FL_LIGHT3);
+      fl_line(X+3, Y+H/2+1, X+w1-3, Y+H/2+1);
+    }
+    if (f->flags & FIELD_UNDERLINE) {
+      fl_color((f->flags & FIELD_UCOLOR) ? f->underline : b->textcolor());
+      fl_line(X+3, Y+H-1, X+w1-3, Y+H-1);
+    }
+    fl_font(field_font(b, f), field_size(b, f));
     if (l->flags & SELECTED)
-      lcol = fl_contrast(lcol, selection_color());
-    if (!active_r()) lcol = fl_inactive(lcol);
+      lcol = fl_contrast(lcol, b->selection_color());
+    if (!b->active_r()) lcol = fl_inactive(lcol);
     fl_color(lcol);
-    fl_draw(str, X+3, Y, w1-6, H, e ? Fl_Align(talign|FL_ALIGN_CLIP) : talign, 0, 0);
-    if (!e) break; // no more fields...
-    *e = column_char(); // put the separator back
+    Fl_Align talign = (Fl_Align)f->align;
+    if (last) {
+      fl_draw(l->txt + f->start, X+3, Y, w1-6, H, talign, 0, 0);
+      break; // no more fields...
+    }
+    char* e = l->txt + f->end;
+    char c = *e;
+    *e = 0; // end the field for fl_draw()
+    fl_draw(l->txt + f->start, X+3, Y, w1-6, H, Fl_Align(talign|FL_ALIGN_CLIP), 0, 0);
+    *e = c; // put the separator back
     X += w1;
     W -= w1;
-    str = e+1;
+    f++;
   }
 }
 
+/**
+  Draws \p item at the position specified by \p X \p Y \p W \p H.
+  The \p W and \p H values are used for clipping.
+  Should only be called within the context of an FLTK draw().
+  \param[in] item The item to be drawn
+  \param[in] X,Y,W,H position and size.
+*/
+void Fl_Browser::item_draw(void* item, int X, int Y, int W, int H) const {
+  Fl_Browser_Rows* r = rows();
+  if (r) draw_line(this, r->materialize(row_line(item)), X, Y, W, H);
+  else draw_line(this, (FL_BLINE*)item, X, Y, W, H);
+}
+
 static const int no_columns[1] = {0};
 
 /**
@@ -622,11 +1013,15 @@ void Fl_Browser::lineposition(int line, Fl_Line_Position pos) {
   if (line>lines) line = lines;
   int p = 0;
 
-  FL_BLINE* l;
-  for (l=first; l && line>1; l = l->next) {
-    line--; p += item_height(l);
+  FL_BLINE* l = find_line(line);
+  Fl_Browser_Rows* r = rows();
+  if (r) {
+    if (l) p = r->position(line);
+    if (l && (pos == BOTTOM)) p += r->height(line);
+  } else {
+    if (l) p = line_position(l);
+    if (l && (pos == BOTTOM)) p += l->height;
   }
-  if (l && (pos == BOTTOM)) p += item_height (l);
 
   int final = p, X, Y, W, H;
   bbox(X, Y, W, H);
@@ -671,11 +1066,73 @@ void Fl_Browser::textsize(Fl_Fontsize newSize) {
     return; // avoid recalculation
   Fl_Browser_::textsize(newSize);
   new_list();
+  update_lines(0);
+}
+
+/**
+  Sets the default text font for the lines in the browser to \p font.
+
+  Like textsize(Fl_Fontsize), this recalculates all item heights and
+  widths, which can be slow if there are many items in the browser.
+  It returns immediately if \p font equals the current textfont().
+*/
+void Fl_Browser::textfont(Fl_Font font) {
+  if (font == textfont())
+    return; // avoid recalculation
+  Fl_Browser_::textfont(font);
+  new_list();
+  update_lines(0);
+}
+
+/**
+  Sets the current format code prefix character to \p c.
+  The default prefix is '\@'.  Set the prefix to 0 to disable formatting.
+
+  The format codes of all lines are parsed again, which can be slow if
+  there are many items in the browser.
+  \see format_char() for list of '\@' codes
+*/
+void Fl_Browser::format_char(char c) {
+  if (c == format_char_) return;
+  format_char_ = c;
+  update_lines(1);
+  redraw();
+}
+
+/**
+  Sets the column separator to c.
+  This will only have an effect if you also set column_widths().
+  The default is '\\t' (tab).
+
+  The columns of all lines are found again, which can be slow if there
+  are many items in the browser.
+  \see column_char(), column_widths()
+*/
+void Fl_Browser::column_char(char c) {
+  if (c == column_char_) return;
+  column_char_ = c;
+  update_lines(1);
+  redraw();
+}
+
+// Measures all lines again, and parses their format codes again first
+// if reparse is set:
+void Fl_Browser::update_lines(int reparse) {
+  Fl_Browser_Rows* r = rows();
+  if (r) {
+    // ask for the heights again, they may depend on the text size:
+    if (r->row_height < 0) {r->nsums = 0; r->resize(lines);}
+    return;
+  }
   full_height_ = 0;
   if (lines == 0) return;
-  for (FL_BLINE* itm=(FL_BLINE *)item_first(); itm; itm=(FL_BLINE *)item_next(itm)) {
-    full_height_ += item_height(itm);
+  for (FL_BLINE* itm = first; itm; itm = itm->next) {
+    if (reparse) parse_line(itm, format_char_, column_char_);
+    itm->width = -1;
+    itm->height = item_height(itm);
+    full_height_ += itm->height;
   }
+  update_totals(Tree::root(first));
 }
 
 /**
@@ -683,14 +1140,27 @@ void Fl_Browser::textsize(Fl_Fontsize newSize) {
   \see add(), insert(), remove(), swap(int,int), clear()
 */
 void Fl_Browser::clear() {
+  Fl_Browser_Rows* r = rows();
+  if (r) {
+    Fl_Browser_Rows** p = &all_rows;
+    while (*p != r) p = &(*p)->next;
+    *p = r->next;
+    free(r->sums);
+    free(r->ranges);
+    if (r->line) free(r->line->fields);
+    free(r->line);
+    free(r);
+  }
   for (FL_BLINE* l = first; l;) {
     FL_BLINE* n = l->next;
-    free(l);
+    free_line(l);
     l = n;
   }
   full_height_ = 0;
   first = 0;
   last = 0;
+  cache = 0;
+  cacheline = 0;
   lines = 0;
   new_list();
 }
@@ -712,6 +1182,209 @@ void Fl_Browser::add(const char* newtext, void* d) {
   //Fl_Browser_::display(last);
 }
 
+/**
+  Adds \p n lines to the end of the browser.
+
+  This does the same as calling add() for each line, but it allocates
+  the lines together in one block, sums their heights once and redraws
+  the browser once. The block is freed when all of its lines are removed.
+
+  \param[in] newtext The label texts of the lines, an entry may be NULL
+             to make a blank line.
+  \param[in] n The number of lines
+  \param[in] d Optional array of user data() for the lines, NULL sets the
+             data() of all lines to NULL.
+  \see add(), load()
+*/
+void Fl_Browser::add_bulk(const char* const* newtext, int n, void* const* d) {
+  if (n <= 0 || rows()) return;
+  int i;
+  size_t size = 0;
+  for (i = 0; i < n; i++)
+    size += slab_size(newtext[i] ? (int) strlen(newtext[i]) : 0);
+  Fl_Browser_Slab* b = new_slab(size, n);
+  char* p = slab_lines(b);
+  int h = 0;
+  for (i = 0; i < n; i++) {
+    const char* s = newtext[i] ? newtext[i] : "";
+    int l = (int) strlen(s);
+    FL_BLINE* t = slab_line(b, p, s, l, d ? d[i] : 0);
+    p += slab_size(l);
+    parse_line(t, format_char_, column_char_);
+    t->height = item_height(t);
+    h += t->height;
+    link_line(t, 0, first, last);
+  }
+  lines += n;
+  full_height_ += h;
+  redraw();
+}
+
+/**
+  Adds the lines of \p text to the end of the browser.
+
+  Each \p separator in \p text ends a line, and the text after the last
+  one is added as another line if it is not empty. The lines are added
+  as by add_bulk(const char* const*, int, void* const*), without
+  copying \p text first.
+
+  \param[in] text The text to add.
+  \param[in] length The length of \p text, or -1 if it is nul-terminated.
+  \param[in] separator The character between the lines.
+  \see add(), load()
+*/
+void Fl_Browser::add_bulk(const char* text, int length, char separator) {
+  if (!text || rows()) return;
+  if (length < 0) length = (int) strlen(text);
+  const char* end = text + length;
+  const char* s;
+  const char* e;
+  int n = 0;
+  size_t size = 0;
+  for (s = text; s < end; s = e + 1) {
+    e = (const char*)memchr(s, separator, end - s);
+    if (!e) e = end;
+    size += slab_size((int)(e - s));
+    n++;
+  }
+  if (!n) return;
+  Fl_Browser_Slab* b = new_slab(size, n);
+  char* p = slab_lines(b);
+  int h = 0;
+  for (s = text; s < end; s = e + 1) {
+    e = (const char*)memchr(s, separator, end - s);
+    if (!e) e = end;
+    int l = (int)(e - s);
+    FL_BLINE* t = slab_line(b, p, s, l, 0);
+    p += slab_size(l);
+    parse_line(t, format_char_, column_char_);
+    t->height = item_height(t);
+    h += t->height;
+    link_line(t, 0, first, last);
+  }
+  lines += n;
+  full_height_ += h;
+  redraw();
+}
+
+/**
+  Puts the browser in virtual mode with \p n lines, or leaves it if \p cb
+  is NULL.
+
+  In virtual mode the browser keeps no copies of the lines: it removes
+  all lines it had, and \p cb describes a line whenever the browser needs
+  it, which is only for the lines that it measures or draws. The
+  callback gets the line number (1 based), an Fl_Browser_Row filled in
+  with the defaults, in which it sets the text, data(), icon, height or
+  format code prefix of the line, and \p data. The text must stay valid
+  until the next call of the callback.
+
+  If \p row_height is greater than zero all lines are that high, and if
+  it is zero (the default) they are as high as a line of text in
+  textfont() and textsize(). Then the height in Fl_Browser_Row is
+  ignored, and scrolling takes constant time if FLTK is built with
+  FLTK_ABI_VERSION 10304 or higher. Older ABI versions lack
+  Fl_Browser_::item_at_position(), so the browser still counts the
+  lines above the top line when it scrolls. If \p row_height is less than zero
+  each line has the height the callback gives: the browser then asks for
+  all lines once to sum their heights, and keeps one int per line.
+
+  The selection is kept as ranges of lines. The methods that change the
+  lines, like add(), insert(), remove(), move(), swap(), text(int, const char*),
+  data(int, void*), icon(int, Fl_Image*), show(int) and hide(int), do nothing
+  in virtual mode, and neither does sorting. Use virtual_rows(int) when
+  the number of lines changes and virtual_changed() when a line changes,
+  or clear() to leave virtual mode.
+
+  Subclasses that draw the lines themselves, like Fl_File_Browser, can not
+  be used in virtual mode.
+
+  \param[in] n the number of lines
+  \param[in] cb the callback that describes the lines
+  \param[in] data the pointer passed to \p cb
+  \param[in] row_height the height of all lines, or 0 or less, see above
+*/
+void Fl_Browser::virtual_rows(int n, Fl_Browser_Row_Cb *cb, void *data, int row_height) {
+  clear();
+  redraw();
+  if (!cb) return;
+  Fl_Browser_Rows* r = (Fl_Browser_Rows*)calloc(1, sizeof(Fl_Browser_Rows));
+  r->browser = this;
+  r->cb = cb;
+  r->data = data;
+  r->row_height = row_height < 0 ? -1 : row_height;
+  r->next = all_rows;
+  all_rows = r;
+  virtual_rows(n);
+}
+
+/**
+  Changes the number of lines of a browser in virtual mode to \p n. The
+  lines before \p n keep their selection, only the lines added are asked
+  for their heights if the lines have their own heights.
+  Does nothing if the browser is not in virtual mode.
+  \see virtual_rows(int, Fl_Browser_Row_Cb*, void*, int)
+*/
+void Fl_Browser::virtual_rows(int n) {
+  Fl_Browser_Rows* r = rows();
+  if (!r) return;
+  if (n < 0) n = 0;
+  for (; lines > n; lines--) deleting(row_item(lines));
+  r->resize(n);
+  lines = n;
+  redraw();
+}
+
+/**
+  Tells a browser in virtual mode that \p line has changed, it asks the
+  callback for the new height of the line if the lines have their own
+  heights, and redraws it.
+  Does nothing if \p line is out of range or not in virtual mode.
+  \see virtual_rows(int, Fl_Browser_Row_Cb*, void*, int)
+*/
+void Fl_Browser::virtual_changed(int line) {
+  Fl_Browser_Rows* r = rows();
+  if (!r || line < 1 || line > lines) return;
+  if (r->row_height < 0) {
+    Fl_Browser_Row row;
+    r->get(line, row);
+    int d = row.height - r->height(line);
+    if (d) {
+      for (int i = line; i <= lines; i += i & -i) r->sums[i] += d;
+      redraw();
+    }
+  }
+  replacing(row_item(line), row_item(line));	// redraws it, and measures its width again
+}
+
+// The sort methods hide the ones of Fl_Browser_, which would sort the
+// items of a browser in virtual mode by texts that no longer exist.
+
+/**
+  Sorts the lines of the browser, see Fl_Browser_::sort(int).
+  Does nothing in virtual mode.
+*/
+void Fl_Browser::sort(int flags) {
+  if (!rows()) Fl_Browser_::sort(flags);
+}
+
+/**
+  Sorts the lines of the browser by one column, see
+  Fl_Browser_::sort(int, int, char). Does nothing in virtual mode.
+*/
+void Fl_Browser::sort(int flags, int column, char column_char) {
+  if (!rows()) Fl_Browser_::sort(flags, column, column_char);
+}
+
+/**
+  Sorts the lines of the browser with a comparison function, see
+  Fl_Browser_::sort(Fl_Browser_Sort_F*, void*, int). Does nothing in
+  virtual mode.
+*/
+void Fl_Browser::sort(Fl_Browser_Sort_F *compare, void *data, int flags) {
+  if (!rows()) Fl_Browser_::sort(compare, data, flags);
+}
+
 /**
   Returns the label text for the specified \p line.
   Return value can be NULL if \p line is out of range or unset.
@@ -721,6 +1394,12 @@ void Fl_Browser::add(const char* newtext, void* d) {
 */
 const char* Fl_Browser::text(int line) const {
   if (line < 1 || line > lines) return 0;
+  Fl_Browser_Rows* r = rows();
+  if (r) {
+    Fl_Browser_Row row;
+    r->get(line, row);
+    return row.text ? row.text : "";
+  }
   return find_line(line)->txt;
 }
 
@@ -734,6 +1413,12 @@ const char* Fl_Browser::text(int line) const {
 */
 void* Fl_Browser::data(int line) const {
   if (line < 1 || line > lines) return 0;
+  Fl_Browser_Rows* r = rows();
+  if (r) {
+    Fl_Browser_Row row;
+    r->get(line, row);
+    return row.data;
+  }
   return find_line(line)->data;
 }
 
@@ -758,6 +1443,8 @@ int Fl_Browser::select(int line, int val) {
   */
 int Fl_Browser::selected(int line) const {
   if (line < 1 || line > lines) return 0;
+  Fl_Browser_Rows* r = rows();
+  if (r) return r->selected(line);
   return find_line(line)->flags & SELECTED;
 }
 
@@ -770,10 +1457,11 @@ int Fl_Browser::selected(int line) const {
   \see show(int), hide(int), display(), visible(), make_visible()
 */
 void Fl_Browser::show(int line) {
+  if (rows()) return;
   FL_BLINE* t = find_line(line);
   if (t->flags & NOTDISPLAYED) {
     t->flags &= ~NOTDISPLAYED;
-    full_height_ += item_height(t);
+    full_height_ += set_height(t, item_height(t));
     if (Fl_Browser_::displayed(t)) redraw();
   }
 }
@@ -788,10 +1476,11 @@ void Fl_Browser::show(int line) {
   \see show(int), hide(int), display(), visible(), make_visible()
 */
 void Fl_Browser::hide(int line) {
+  if (rows()) return;
   FL_BLINE* t = find_line(line);
   if (!(t->flags & NOTDISPLAYED)) {
-    full_height_ -= item_height(t);
     t->flags |= NOTDISPLAYED;
+    full_height_ += set_height(t, 0);
     if (Fl_Browser_::displayed(t)) redraw();
   }
 }
@@ -815,6 +1504,8 @@ void Fl_Browser::display(int line, int val) {
 */
 int Fl_Browser::visible(int line) const {
   if (line < 1 || line > lines) return 0;
+  Fl_Browser_Rows* r = rows();
+  if (r) return r->height(line) > 0;
   return !(find_line(line)->flags&NOTDISPLAYED);
 }
 
@@ -836,36 +1527,22 @@ int Fl_Browser::value() const {
 void Fl_Browser::swap(FL_BLINE *a, FL_BLINE *b) {
 
   if ( a == b || !a || !b) return;          // nothing to do
+  if (rows()) return;       // the order is the callback's
   swapping(a, b);
-  FL_BLINE *aprev  = a->prev;
-  FL_BLINE *anext  = a->next;
-  FL_BLINE *bprev  = b->prev;
-  FL_BLINE *bnext  = b->next;
-  if ( b->prev == a ) { 		// A ADJACENT TO B
-     if ( aprev ) aprev->next = b; else first = b;
-     b->next = a;
-     a->next = bnext;
-     b->prev = aprev;
-     a->prev = b;
-     if ( bnext ) bnext->prev = a; else last = a;
-  } else if ( a->prev == b ) {		// B ADJACENT TO A
-     if ( bprev ) bprev->next = a; else first = a;
-     a->next = b;
-     b->next = anext;
-     a->prev = bprev;
-     b->prev = a;
-     if ( anext ) anext->prev = b; else last = b;
+  FL_BLINE *anext = a->next;
+  FL_BLINE *bnext = b->next;
+  // take them out and put them back at the other's place:
+  if (anext == b) {			// A ADJACENT TO B
+    unlink_line(a, first, last);
+    link_line(a, bnext, first, last);
+  } else if (bnext == a) {		// B ADJACENT TO A
+    unlink_line(b, first, last);
+    link_line(b, anext, first, last);
   } else {				// A AND B NOT ADJACENT
-     // handle prev's
-     b->prev = aprev;
-     if ( anext ) anext->prev = b; else last = b;
-     a->prev = bprev;
-     if ( bnext ) bnext->prev = a; else last = a;
-     // handle next's
-     if ( aprev ) aprev->next = b; else first = b;
-     b->next = anext;
-     if ( bprev ) bprev->next = a; else first = a;
-     a->next = bnext;
+    unlink_line(a, first, last);
+    unlink_line(b, first, last);
+    link_line(a, bnext, first, last);
+    link_line(b, anext, first, last);
   }
   // Disable cache -- we played around with positions
   cacheline = 0;
@@ -895,7 +1572,7 @@ void Fl_Browser::swap(int a, int b) {
 */
 void Fl_Browser::icon(int line, Fl_Image* icon) {
 
-  if (line<1 || line > lines) return;
+  if (line<1 || line > lines || rows()) return;
 
   FL_BLINE* bl = find_line(line);
 
@@ -906,9 +1583,9 @@ void Fl_Browser::icon(int line, Fl_Image* icon) {
   if (th > old_h) old_h = th;
   if (th > new_h) new_h = th;
   int dh = new_h - old_h;
-  full_height_ += dh;				// do this *always*
 
   bl->icon = icon;				// set new icon
+  full_height_ += set_height(bl, item_height(bl));	// do this *always*
   if (dh>0) {
     redraw();					// icon larger than item? must redraw widget
   } else {
@@ -924,6 +1601,13 @@ void Fl_Browser::icon(int line, Fl_Image* icon) {
   \returns The icon defined, or NULL if none.
 */
 Fl_Image* Fl_Browser::icon(int line) const {
+  if (line < 1 || line > lines) return 0;
+  Fl_Browser_Rows* r = rows();
+  if (r) {
+    Fl_Browser_Row row;
+    r->get(line, row);
+    return row.icon;
+  }
   FL_BLINE* l = find_line(line);
   return(l ? l->icon : NULL);
 }
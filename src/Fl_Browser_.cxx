@@ -19,10 +19,14 @@
 #define DISPLAY_SEARCH_BOTH_WAYS_AT_ONCE
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <FL/Fl.H>
 #include <FL/Fl_Widget.H>
 #include <FL/Fl_Browser_.H>
 #include <FL/fl_draw.H>
+#include "Fl_Hash_Table.H"
 
 
 // This is the base class for browsers.  To be useful it must be
@@ -50,6 +54,89 @@
    4 = redraw all items
 */
 
+#if FLTK_ABI_VERSION >= 10304
+
+// The widths of the items measured by draw(), so that when the widest
+// item is deleted or replaced full_width() drops to the next widest one
+// instead of starting over at 0. The items are kept in a hash table with
+// their width, and the distinct widths in a sorted array together with
+// the number of items having each of them, the widest one last.
+struct Fl_Browser_Width {
+  int width;		// width in pixels
+  int count;		// number of items this wide
+};
+
+struct Fl_Browser_Widths {
+  Fl_Hash_Table<void*, int> item; // the measured items and their widths
+  Fl_Browser_Width *width; // the distinct widths, in increasing order
+  int widths;		// number of distinct widths
+  int alloc;		// size of width
+
+  Fl_Browser_Widths() : width(0), widths(0), alloc(0) {}
+  ~Fl_Browser_Widths() {free(width);}
+  int max() const {return widths ? width[widths-1].width : 0;}
+  int find_width(int w) const;
+  void add_width(int w);
+  void remove_width(int w);
+  void set(void *p, int w);
+  void remove(void *p);
+};
+
+// Returns the index of width w, or where it would be inserted:
+int Fl_Browser_Widths::find_width(int w) const {
+  int a = 0, b = widths;
+  while (a < b) {
+    int m = (a+b)/2;
+    if (width[m].width < w) a = m+1; else b = m;
+  }
+  return a;
+}
+
+void Fl_Browser_Widths::add_width(int w) {
+  int i = find_width(w);
+  if (i < widths && width[i].width == w) {width[i].count++; return;}
+  if (widths >= alloc) {
+    alloc = alloc ? 2*alloc : 64;
+    width = (Fl_Browser_Width*)realloc(width, alloc*sizeof(Fl_Browser_Width));
+  }
+  memmove(width+i+1, width+i, (widths-i)*sizeof(Fl_Browser_Width));
+  width[i].width = w;
+  width[i].count = 1;
+  widths++;
+}
+
+void Fl_Browser_Widths::remove_width(int w) {
+  int i = find_width(w);
+  if (i >= widths || width[i].width != w) return;
+  if (--width[i].count) return;
+  widths--;
+  memmove(width+i, width+i+1, (widths-i)*sizeof(Fl_Browser_Width));
+}
+
+// Records that item p is w pixels wide:
+void Fl_Browser_Widths::set(void *p, int w) {
+  unsigned h = item.hash_pointer(p);
+  int i = item.find(p, h);
+  if (i >= 0) {
+    if (item.value(i) == w) return;
+    remove_width(item.value(i));
+  } else {
+    i = item.insert(p, h);
+  }
+  item.value(i) = w;
+  add_width(w);
+}
+
+// Forgets the width of item p:
+void Fl_Browser_Widths::remove(void *p) {
+  int i = item.find(p, item.hash_pointer(p));
+  if (i < 0) return;
+  remove_width(item.value(i));
+  item.remove_at(i);
+}
+
+#endif
+
 static void scrollbar_callback(Fl_Widget* s, void*) {
   ((Fl_Browser_*)(s->parent()))->position(int(((Fl_Scrollbar*)s)->value()));
 }
@@ -114,6 +201,10 @@ void Fl_Browser_::resize(int X, int Y, int W, int H) {
 	X, scrollbar.align()&FL_ALIGN_TOP ? Y-scrollsize : Y+H,
 	W, scrollsize);
   max_width = 0;
+#if FLTK_ABI_VERSION >= 10304
+  delete widths_;
+  widths_ = 0;
+#endif
 }
 
 // Cause minimal update to redraw the given item:
@@ -136,6 +227,13 @@ void Fl_Browser_::update_top() {
     void* l;
     int ly;
     int yy = position_;
+#if FLTK_ABI_VERSION >= 10304
+    // the subclass may know the item at this position:
+    if ((l = item_at_position(yy, ly)) != 0) {
+      int hh = item_quick_height(l);
+      if ((ly+hh) <= yy) yy = ly+hh-1;	// below the last item
+    } else
+#endif
     // start from either head or current position, whichever is closer:
     if (!top_ || yy <= (real_position_/2)) {
       l = item_first();
@@ -227,6 +325,10 @@ void Fl_Browser_::hposition(int pos) {
 */
 int Fl_Browser_::displayed(void* item) const {
   int X, Y, W, H; bbox(X, Y, W, H);
+#if FLTK_ABI_VERSION >= 10304
+  int p = item_position(item);
+  if (p >= 0) return top_ && p >= real_position_-offset_ && p < real_position_+H;
+#endif
   int yy = H+offset_;
   for (void* l = top_; l && yy > 0; l = item_next(l)) {
     if (l == item) return 1;
@@ -260,6 +362,28 @@ void Fl_Browser_::display(void* item) {
   void* lp = item_prev(l);
   if (lp == item) {position(real_position_+Y-item_quick_height(lp)); return;}
 
+#if FLTK_ABI_VERSION >= 10304
+  // the subclass may know where the item is:
+  int p = item_position(item);
+  if (p >= 0) {
+    h1 = item_quick_height(item);
+    if (p >= real_position_+Y) {	// below top()
+      Y = p-real_position_;
+      if (Y <= H) { // it is visible or right at bottom
+	Y = Y+h1-H; // find where bottom edge is
+	if (Y > 0) position(real_position_+Y); // scroll down a bit
+      } else {
+	position(real_position_+Y-(H-h1)/2); // center it
+      }
+    } else {
+      Yp = p-real_position_;
+      if ((Yp + h1) >= 0) position(real_position_+Yp);
+      else position(real_position_+Yp-(H-h1)/2);
+    }
+    return;
+  }
+#endif
+
 #ifdef DISPLAY_SEARCH_BOTH_WAYS_AT_ONCE
   // search for item.  We search both up and down the list at the same time,
   // this evens up the execution time for the two cases - the old way was
@@ -413,7 +537,13 @@ J1:
 	draw_focus(FL_NO_BOX, X, yy+Y, W+1, hh+1);
       }
       int ww = item_width(l);
+#if FLTK_ABI_VERSION >= 10304
+      if (!widths_) widths_ = new Fl_Browser_Widths;
+      widths_->set(l, ww);
+      max_width = widths_->max();
+#else
       if (ww > max_width) {max_width = ww; max_width_item = l;}
+#endif
     }
     yy += hh;
   }
@@ -495,6 +625,10 @@ void Fl_Browser_::new_list() {
   offset_ = 0;
   max_width = 0;
   max_width_item = 0;
+#if FLTK_ABI_VERSION >= 10304
+  delete widths_;
+  widths_ = 0;
+#endif
   redraw_lines();
 }
 
@@ -523,7 +657,11 @@ void Fl_Browser_::deleting(void* item) {
     top_ = 0;
   }
   if (item == selection_) selection_ = 0;
+#if FLTK_ABI_VERSION >= 10304
+  if (widths_) {widths_->remove(item); max_width = widths_->max();}
+#else
   if (item == max_width_item) {max_width_item = 0; max_width = 0;}
+#endif
 }
 
 /**
@@ -539,7 +677,16 @@ void Fl_Browser_::replacing(void* a, void* b) {
   redraw_line(a);
   if (a == selection_) selection_ = b;
   if (a == top_) top_ = b;
+#if FLTK_ABI_VERSION >= 10304
+  // the new item is measured again when it is drawn:
+  if (widths_) {
+    widths_->remove(a);
+    if (b != a) widths_->remove(b);
+    max_width = widths_->max();
+  }
+#else
   if (a == max_width_item) {max_width_item = 0; max_width = 0;}
+#endif
 }
 
 /**
@@ -977,54 +1124,196 @@ Fl_Browser_::Fl_Browser_(int X, int Y, int W, int H, const char* L)
   max_width_item = 0;
   scrollbar_size_ = 0;
   redraw1 = redraw2 = 0;
+#if FLTK_ABI_VERSION >= 10304
+  widths_ = 0;
+#endif
   end();
 }
 
+/**
+  Destroys the browser. The subclass is responsible for its items.
+*/
+Fl_Browser_::~Fl_Browser_() {
+#if FLTK_ABI_VERSION >= 10304
+  delete widths_;
+#endif
+}
+
+// Sorting:
+
+struct Fl_Browser_Sort_Item {
+  void *item;
+  const char *text;	// the text, or the column, to compare
+  int index;		// position of the item before sorting
+};
+
+struct Fl_Browser_Sort_Data {
+  Fl_Browser_Sort_F *compare;
+  void *data;
+  int flags;
+  char column_char;	// end of a column, '\0' to compare the whole text
+};
+
+// Compares two texts up to the end of the column, like strcmp(), or
+// like fl_numericsort() with FL_SORT_NUMERIC:
+static int compare_text(const char *a, const char *b, int flags, char end) {
+  int ci = flags & FL_SORT_CASEINSENSITIVE;
+  for (;;) {
+    int ca = (*a == end) ? 0 : (*a & 255);
+    int cb = (*b == end) ? 0 : (*b & 255);
+    if ((flags & FL_SORT_NUMERIC) && isdigit(ca) && isdigit(cb)) {
+      // compare the number of significant digits, then the first that differs:
+      while (*a == '0') a++;
+      while (*b == '0') b++;
+      while (isdigit(*a & 255) && *a == *b) {a++; b++;}
+      int diff = (isdigit(*a & 255) && isdigit(*b & 255)) ? *a - *b : 0;
+      int magdiff = 0;
+      while (isdigit(*a & 255)) {magdiff++; a++;}
+      while (isdigit(*b & 255)) {magdiff--; b++;}
+      if (magdiff) return magdiff;
+      if (diff) return diff;
+      continue;
+    }
+    if (ci) {ca = tolower(ca); cb = tolower(cb);}
+    if (ca != cb) return ca - cb;
+    if (!ca) return 0;
+    a++; b++;
+  }
+}
+
+static int compare_items(const Fl_Browser_Sort_Item *a, const Fl_Browser_Sort_Item *b,
+                         const Fl_Browser_Sort_Data &d) {
+  int r;
+  if (d.compare) r = d.compare(a->text, b->text, d.data);
+  else r = compare_text(a->text, b->text, d.flags, d.column_char);
+  return (d.flags & FL_SORT_DESCENDING) ? -r : r;
+}
+
+// Stable merge sort of n items, tmp must have room for n items:
+static void merge_sort(Fl_Browser_Sort_Item *a, Fl_Browser_Sort_Item *tmp, int n,
+                       const Fl_Browser_Sort_Data &d) {
+  if (n < 8) {
+    for (int i = 1; i < n; i++) {
+      Fl_Browser_Sort_Item t = a[i];
+      int j = i;
+      for (; j > 0 && compare_items(a + j - 1, &t, d) > 0; j--) a[j] = a[j-1];
+      a[j] = t;
+    }
+    return;
+  }
+  int h = n / 2;
+  merge_sort(a, tmp, h, d);
+  merge_sort(a + h, tmp, n - h, d);
+  if (compare_items(a + h - 1, a + h, d) <= 0) return;	// already in order
+  int i = 0, j = h, k = 0;
+  while (i < h && j < n) tmp[k++] = (compare_items(a + j, a + i, d) < 0) ? a[j++] : a[i++];
+  while (i < h) tmp[k++] = a[i++];
+  // the rest of the second half is in place already
+  for (i = 0; i < k; i++) a[i] = tmp[i];
+}
+
+static const char *skip_columns(const char *t, int column, char column_char) {
+  for (; column > 0 && *t; column--) {
+    while (*t && *t != column_char) t++;
+    if (*t) t++;
+  }
+  return t;
+}
+
+// Sorts the items with a merge sort and moves them into place with at
+// most one item_swap() per item:
+void Fl_Browser_::sort(const Fl_Browser_Sort_Data &d, int column) {
+  int n = 0, i;
+  void *a;
+  for (a = item_first(); a; a = item_next(a)) n++;
+  if (n < 2) return;
+  Fl_Browser_Sort_Item *items = (Fl_Browser_Sort_Item*)malloc(2 * n * sizeof(Fl_Browser_Sort_Item));
+  Fl_Browser_Sort_Item *tmp = items + n;
+  for (a = item_first(), i = 0; a; a = item_next(a), i++) {
+    const char *t = item_text(a);
+    if (!t) t = "";
+    if (column > 0) t = skip_columns(t, column, d.column_char);
+    items[i].item = a;
+    items[i].text = t;
+    items[i].index = i;
+  }
+  merge_sort(items, tmp, n, d);
+  // item[k] is the item that was at position k before sorting, pos[k]
+  // where it is now, and occ[p] the old position of the item now at p:
+  void **item = (void**)tmp;
+  int *pos = (int*)(item + n);
+  int *occ = pos + n;
+  for (i = 0; i < n; i++) {
+    item[items[i].index] = items[i].item;
+    pos[i] = occ[i] = i;
+  }
+  for (i = 0; i < n; i++) {
+    int o = items[i].index, j = pos[o];
+    if (j == i) continue;
+    int q = occ[i];
+    item_swap(item[q], item[o]);
+    pos[o] = i; occ[i] = o;
+    pos[q] = j; occ[j] = q;
+  }
+  free(items);
+  redraw_lines();
+}
 /**
   Sort the items in the browser based on \p flags.
   item_swap(void*, void*) and item_text(void*) must be implemented for this call.
+
+  The sort is stable, items that compare equal keep their order. It takes
+  O(n log n) comparisons and at most one item_swap() per item, and the
+  browser is redrawn once.
+
   \param[in] flags FL_SORT_ASCENDING -- sort in ascending order\n
                    FL_SORT_DESCENDING -- sort in descending order\n
-		   Values other than the above will cause undefined behavior\n
-		   Other flags may appear in the future.
-  \todo Add a flag to ignore case
+                   FL_SORT_CASEINSENSITIVE -- ignore the case of letters\n
+                   FL_SORT_NUMERIC -- compare numbers by value, like fl_numericsort()\n
+                   Other flags may appear in the future.
 */
 void Fl_Browser_::sort(int flags) {
-  //
-  // Simple bubble sort - pure lazyness on my side.
-  //
-  int i, j, n = -1, desc = ((flags&FL_SORT_DESCENDING)==FL_SORT_DESCENDING);
-  void *a =item_first(), *b, *c;
-  if (!a) return;
-  while (a) {
-    a = item_next(a);
-    n++;
-  }
-  for (i=n; i>0; i--) {
-    char swapped = 0;
-    a = item_first();
-    b = item_next(a);
-    for (j=0; j<i; j++) {
-      const char *ta = item_text(a);
-      const char *tb = item_text(b);
-      c = item_next(b);
-      if (desc) {
-        if (strcmp(ta, tb)<0) {
-          item_swap(a, b);
-          swapped = 1;
-        }
-      } else {
-        if (strcmp(ta, tb)>0) {
-          item_swap(a, b);
-          swapped = 1;
-        }
-      }
-      if (!c) break;
-      b = c; a = item_prev(b);
-    }
-    if (!swapped)
-      break;
-  }
+  sort(flags, 0, '\0');
+}
+
+/**
+  Sort the items in the browser by one column of their text.
+
+  The columns of an item are separated by \p column_char, as in
+  Fl_Browser::column_char(). Items are compared by the text of column
+  \p column, counting from 0, up to the next \p column_char.
+
+  \param[in] flags see sort(int)
+  \param[in] column the column to compare
+  \param[in] column_char the character that separates the columns
+*/
+void Fl_Browser_::sort(int flags, int column, char column_char) {
+  Fl_Browser_Sort_Data d;
+  d.compare = 0;
+  d.data = 0;
+  d.flags = flags;
+  d.column_char = column_char;
+  sort(d, column);
+}
+
+/**
+  Sort the items in the browser with a comparison function.
+
+  \p compare gets the item_text() of two items and \p data, and returns
+  a negative value, 0 or a positive value if the first item goes before,
+  at the same position or after the second, like strcmp().
+
+  \param[in] compare the comparison function
+  \param[in] data passed to \p compare
+  \param[in] flags FL_SORT_DESCENDING reverses the order of \p compare
+*/
+void Fl_Browser_::sort(Fl_Browser_Sort_F *compare, void *data, int flags) {
+  Fl_Browser_Sort_Data d;
+  d.compare = compare;
+  d.data = data;
+  d.flags = flags;
+  d.column_char = '\0';
+  sort(d, 0);
 }
 
 // Default versions of some of the virtual functions:
@@ -1070,13 +1359,57 @@ int Fl_Browser_::full_height() const {
 /**
   This method may be provided by the subclass to indicate the full width
   of the item list, in pixels. 
-  The default implementation computes the full width from the item widths.
+  The default implementation returns the width of the widest item that
+  was drawn so far. With FLTK_ABI_VERSION 10304 or higher the widths of
+  all the items drawn are remembered, so that deleting or replacing the
+  widest item falls back to the next widest one.
   \returns The maximum width of all the items, in pixels.
 */
 int Fl_Browser_::full_width() const {
   return max_width;
 }
 
+#if FLTK_ABI_VERSION >= 10304 || defined(FL_DOXYGEN)
+
+/**
+  This method may be provided by the subclass to find the item at a
+  vertical position quickly, e.g. from an index of the item heights.
+
+  It returns the item that contains pixel \p pos of the list, where 0 is
+  the top edge of the first item, and sets \p item_pos to the position
+  of the top edge of that item. If \p pos is below the last item, it
+  returns the last item whose height is not 0.
+
+  The default implementation returns NULL, then Fl_Browser_ steps
+  through the items from top() to find it.
+
+  \note Availability in FLTK_ABI_VERSION 10304 or higher.
+  \see item_position()
+*/
+void *Fl_Browser_::item_at_position(int pos, int &item_pos) const {
+  (void)pos;
+  item_pos = 0;
+  return 0L;
+}
+
+/**
+  This method may be provided by the subclass to return the vertical
+  position of the top edge of \p item quickly, i.e. the sum of the
+  heights of the items before it.
+
+  The default implementation returns -1, then Fl_Browser_ steps through
+  the items from top() to find it.
+
+  \note Availability in FLTK_ABI_VERSION 10304 or higher.
+  \see item_at_position()
+*/
+int Fl_Browser_::item_position(void *item) const {
+  (void)item;
+  return -1;
+}
+
+#endif
+
 /**
   This method must be implemented by the subclass if it supports 
   multiple selections; sets the selection state to \p val for the \p item.
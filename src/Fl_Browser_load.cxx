@@ -19,6 +19,8 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Browser.H>
 #include <stdio.h>
+#include <stdlib.h>
+#include "flstring.h"
 #include <FL/fl_utf8.h>
 
 /**
@@ -28,32 +30,50 @@
   was any error in opening or reading the file, in which case errno
   is set to the system error.  The data() of each line is set
   to NULL.
+
+  A newline or a nul character ends a line. The file is read in blocks,
+  and the lines of each block are added with add_bulk().
   \param[in] filename The filename to load
   \returns 1 if OK, 0 on error (errno has reason)
-  \see add()
+  \see add(), add_bulk()
 */
 int Fl_Browser::load(const char *filename) {
-#define MAXFL_BLINE 1024
-    char newtext[MAXFL_BLINE];
-    int c;
-    int i;
     clear();
     if (!filename || !(filename[0])) return 1;
     FILE *fl = fl_fopen(filename,"r");
     if (!fl) return 0;
-    i = 0;
-    do {
-	c = getc(fl);
-	if (c == '\n' || c <= 0 || i>=(MAXFL_BLINE-1)) {
-	    newtext[i] = 0;
-	    add(newtext);
-	    i = 0;
-	} else {
-	    newtext[i++] = c;
+    int size = 65536;
+    int used = 0;			// bytes in buf
+    int scanned = 0;			// bytes in buf without a newline
+    char *buf = (char *)malloc(size + 1);
+    for (;;) {
+	if (used == size) {		// a line longer than the buffer
+	    size *= 2;
+	    buf = (char *)realloc(buf, size + 1);
+	}
+	int n = (int) fread(buf + used, 1, size - used, fl);
+	if (n <= 0) break;
+	// a nul ends a line like a newline:
+	for (char *z = buf + used; (z = (char *)memchr(z, 0, buf + used + n - z)); )
+	    *z++ = '\n';
+	used += n;
+	// add all complete lines, keep the start of the last one:
+	char *e = buf + used;
+	while (e > buf + scanned && e[-1] != '\n') e--;
+	if (e > buf + scanned) {
+	    add_bulk(buf, (int)(e - buf));
+	    used -= (int)(e - buf);
+	    memmove(buf, e, used);
 	}
-    } while (c >= 0);
+	scanned = used;
+    }
+    int ok = !ferror(fl);
     fclose(fl);
-    return 1;
+    // the text after the last newline is the last line, even if empty:
+    buf[used] = 0;
+    add(buf);
+    free(buf);
+    return ok;
 }
 
 //
@@ -21,9 +21,20 @@
 #include "flstring.h"
 #include <FL/fl_draw.H>
 #include <FL/Fl_Check_Browser.H>
+#include "Fl_Treap.H"
 
-/* This uses a cache for faster access when you're scanning the list
-either forwards or backwards. */
+typedef Fl_Check_Browser::cb_item cb_item;
+
+/* The items are kept in a doubly linked list, and are also the nodes of
+a balanced binary tree (a treap) in list order, in which each node counts
+the items of its subtree. The tree finds the item with a given number,
+and the number of an item, in O(log n). Its root is found from the first
+item, see Fl_Treap.H. */
+
+typedef Fl_Treap<cb_item> Tree;
+
+/* This also uses a cache for faster access when you're scanning the
+list forwards or backwards. */
 
 Fl_Check_Browser::cb_item *Fl_Check_Browser::find_item(int n) const {
 	int i = n;
@@ -35,17 +46,12 @@ Fl_Check_Browser::cb_item *Fl_Check_Browser::find_item(int n) const {
 
 	if (n == cached_item) {
 		p = cache;
-		n = 1;
 	} else if (n == cached_item + 1) {
 		p = cache->next;
-		n = 1;
 	} else if (n == cached_item - 1) {
 		p = cache->prev;
-		n = 1;
-	}
-
-	while (--n) {
-		p = p->next;
+	} else {
+		p = Tree::find(Tree::root(p), n);
 	}
 
 	/* Cast to not const and cache it. */
@@ -57,22 +63,11 @@ Fl_Check_Browser::cb_item *Fl_Check_Browser::find_item(int n) const {
 }
 
 int Fl_Check_Browser::lineno(cb_item *p0) const {
-	cb_item *p = first;
-
-	if (p == 0) {
+	if (p0 == 0) {
 		return 0;
 	}
 
-	int i = 1;
-	while (p) {
-		if (p == p0) {
-			return i;
-		}
-		i++;
-		p = p->next;
-	}
-
-	return 0;
+	return Tree::index(p0);
 }
 
 Fl_Check_Browser::Fl_Check_Browser(int X, int Y, int W, int H, const char *l)
@@ -173,7 +168,7 @@ int Fl_Check_Browser::add(char *s, int b) {
 	cb_item *p = (cb_item *)malloc(sizeof(cb_item));
 	p->next = 0;
 	p->prev = 0;
-	p->checked = b;
+	p->checked = b ? 1 : 0;
 	p->selected = 0;
 	p->text = strdup(s);
 
@@ -181,6 +176,7 @@ int Fl_Check_Browser::add(char *s, int b) {
 		nchecked_++;
 	}
 
+	Tree::insert(p, 0, last);
 	if (last == 0) {
 		first = last = p;
 	} else {
@@ -210,6 +206,7 @@ int Fl_Check_Browser::remove(int item) {
       --nchecked_;
     
     // remove the node
+    Tree::remove(p);
     if (p->prev) 
       p->prev->next = p->next;
     else 
@@ -263,6 +260,7 @@ int Fl_Check_Browser::checked(int i) const {
 void Fl_Check_Browser::checked(int i, int b) {
 	cb_item *p = find_item(i);
 
+	b = b ? 1 : 0;
 	if (p && (p->checked ^ b)) {
 		p->checked = b;
 		if (b) {
@@ -291,6 +289,10 @@ char *Fl_Check_Browser::text(int i) const {
 void Fl_Check_Browser::check_all() {
 	cb_item *p;
 
+	if (nchecked_ == nitems_) {
+		return;
+	}
+
 	nchecked_ = nitems_;
 	for (p = first; p; p = p->next) {
 		p->checked = 1;
@@ -302,6 +304,10 @@ void Fl_Check_Browser::check_all() {
 void Fl_Check_Browser::check_none() {
 	cb_item *p;
 
+	if (nchecked_ == 0) {
+		return;
+	}
+
 	nchecked_ = 0;
 	for (p = first; p; p = p->next) {
 		p->checked = 0;
@@ -0,0 +1,395 @@
+//
+// "$Id$"
+//
+// Event recorder for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2016 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// File format: the 4 characters "FLEV" and a version byte, followed by
+// records that start with a type character:
+//
+//   'W' window:  id, w, h, label length, label
+//   'E' event:   microseconds since the previous event, event number,
+//                window id, x, y, state, keysym, original keysym,
+//                dx, dy, clicks, is_click, text length, text
+//
+// Numbers are stored as variable length integers, 7 bits per byte with
+// the high bit set on all but the last byte. Signed numbers are zigzag
+// encoded first. Window ids start at 1 in the order the windows first
+// received an event, 0 is used for events without a window.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Event_Recorder.H>
+#include <FL/Fl_Window.H>
+#include "fl_loop_stats.h"
+#include "flstring.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FILE_VERSION 1
+
+static char read_environment();
+
+char fl_record_events = read_environment();
+
+static FILE *record_file;
+static double record_last;		// time of the last recorded event
+static Fl_Window **record_windows;	// index + 1 is the window id
+static int record_nwindows, record_wsize;
+
+static void put_uint(unsigned long v) {
+  while (v >= 0x80) {
+    putc((int)(v & 0x7f) | 0x80, record_file);
+    v >>= 7;
+  }
+  putc((int)v, record_file);
+}
+
+static void put_int(long v) {
+  put_uint(v < 0 ? ((unsigned long)(-(v + 1)) << 1) | 1 : (unsigned long)v << 1);
+}
+
+static void put_string(const char *s, int n) {
+  put_uint(n);
+  if (n) fwrite(s, 1, n, record_file);
+}
+
+static int window_id(Fl_Window *win) {
+  if (!win) return 0;
+  int i;
+  for (i = 0; i < record_nwindows; i++) if (record_windows[i] == win) return i + 1;
+  if (record_nwindows >= record_wsize) {
+    record_wsize = record_wsize ? 2 * record_wsize : 16;
+    record_windows = (Fl_Window**)realloc(record_windows, record_wsize * sizeof(Fl_Window*));
+  }
+  record_windows[record_nwindows++] = win;
+  const char *l = win->label();
+  putc('W', record_file);
+  put_uint(record_nwindows);
+  put_uint(win->w());
+  put_uint(win->h());
+  put_string(l, l ? (int) strlen(l) : 0);
+  return record_nwindows;
+}
+
+// Called by Fl::handle() for every event from the system.
+void fl_record_event(int e, Fl_Window *window) {
+  if (!record_file) return;
+  int id = window_id(window);
+  double now = fl_loop_stat_time();
+  double dt = record_last > 0.0 ? now - record_last : 0.0;
+  record_last = now;
+  putc('E', record_file);
+  put_uint(dt > 0.0 ? (unsigned long)(dt * 1000000.0) : 0);
+  put_uint(e);
+  put_uint(id);
+  put_int(Fl::e_x);
+  put_int(Fl::e_y);
+  put_uint((unsigned)Fl::e_state);
+  put_uint((unsigned)Fl::e_keysym);
+  put_uint((unsigned)Fl::e_original_keysym);
+  put_int(Fl::e_dx);
+  put_int(Fl::e_dy);
+  put_int(Fl::e_clicks);
+  put_uint(Fl::e_is_click ? 1 : 0);
+  put_string(Fl::e_text, Fl::e_text ? Fl::e_length : 0);
+}
+
+/**
+  Starts recording events to a file.
+
+  A recording in progress is stopped first. Each call creates a new file.
+
+  \param[in] filename the file to write, in UTF-8
+  \returns 0 on success, -1 if the file could not be created
+*/
+int Fl_Event_Recorder::start(const char *filename) {
+  stop();
+  record_file = fl_fopen(filename, "wb");
+  if (!record_file) return -1;
+  fwrite("FLEV", 1, 4, record_file);
+  putc(FILE_VERSION, record_file);
+  record_last = 0.0;
+  record_nwindows = 0;
+  fl_record_events = 1;
+  return 0;
+}
+
+/**
+  Stops recording and closes the file.
+*/
+void Fl_Event_Recorder::stop() {
+  fl_record_events = 0;
+  if (!record_file) return;
+  fclose(record_file);
+  record_file = 0;
+}
+
+/**
+  Returns non-zero while events are recorded.
+*/
+int Fl_Event_Recorder::recording() {
+  return fl_record_events;
+}
+
+////////////////////////////////////////////////////////////////
+// Replay
+
+struct Event_Reader {
+  const unsigned char *p, *end;
+  int error;
+  unsigned long get_uint() {
+    unsigned long v = 0;
+    for (int shift = 0; ; shift += 7) {
+      if (p >= end || shift > 63) {error = 1; return 0;}
+      unsigned char c = *p++;
+      v |= (unsigned long)(c & 0x7f) << shift;
+      if (!(c & 0x80)) return v;
+    }
+  }
+  long get_int() {
+    unsigned long v = get_uint();
+    return (v & 1) ? -(long)(v >> 1) - 1 : (long)(v >> 1);
+  }
+  const char *get_string(int &n) {
+    n = (int)get_uint();
+    if (n < 0 || end - p < n) {error = 1; n = 0; return 0;}
+    const char *s = (const char*)p;
+    p += n;
+    return s;
+  }
+};
+
+struct Replay_Window {
+  Fl_Window *window;	// the window this id was matched to, or NULL
+  const char *label;	// not nul-terminated
+  int length;
+};
+
+// Windows a recorded id can be matched to.
+static Fl_Window **candidates;
+static int ncandidates, candidates_size;
+
+static void add_candidates(Fl_Widget *o) {
+  if (!o->visible()) return;
+  if (o->as_window()) {
+    if (ncandidates >= candidates_size) {
+      candidates_size = candidates_size ? 2 * candidates_size : 16;
+      candidates = (Fl_Window**)realloc(candidates, candidates_size * sizeof(Fl_Window*));
+    }
+    candidates[ncandidates++] = o->as_window();
+  }
+  Fl_Group *g = o->as_group();
+  if (g) for (int i = 0; i < g->children(); i++) add_candidates(g->child(i));
+}
+
+static int is_candidate(Fl_Window *w) {
+  for (int i = 0; i < ncandidates; i++) if (candidates[i] == w) return 1;
+  return 0;
+}
+
+static int same_label(Fl_Window *w, const Replay_Window &r) {
+  const char *l = w->label();
+  int n = l ? (int) strlen(l) : 0;
+  return n == r.length && (!n || !memcmp(l, r.label, n));
+}
+
+// Returns the window for a recorded id, or NULL if there is none.
+// The candidates are searched again for every event because windows
+// may have been deleted since the last one.
+static Fl_Window *find_window(Replay_Window *windows, int nwindows, int id, Fl_Window *window) {
+  if (id < 1 || id > nwindows) return 0;
+  ncandidates = 0;
+  if (window) add_candidates(window);
+  for (Fl_Window *w = Fl::first_window(); w; w = Fl::next_window(w)) add_candidates(w);
+  Replay_Window &r = windows[id - 1];
+  if (r.window && is_candidate(r.window) && same_label(r.window, r)) return r.window;
+  for (int i = 0; i < ncandidates; i++) {
+    Fl_Window *w = candidates[i];
+    if (!same_label(w, r)) continue;
+    int taken = 0;
+    for (int j = 0; j < nwindows && !taken; j++)
+      if (j != id - 1 && windows[j].window == w) taken = 1;
+    if (taken) continue;
+    r.window = w;
+    return w;
+  }
+  return 0;
+}
+
+/**
+  Replays a file written by the recorder.
+
+  Every event is sent with Fl::handle() to the window it was recorded
+  for, followed by Fl::flush(). The time this takes is a frame time
+  and is added to \p stats. Windows are matched by their label, among
+  the shown windows and \p window and its subwindows. Events for windows
+  that can not be found are skipped.
+
+  With a \p speed of 1.0 the events are sent at the rate they were
+  recorded, and Fl::wait() is called in between so that timeouts and
+  other callbacks run as in the recorded session. Other values speed
+  up or slow down the replay, 0.0 sends the events as fast as possible
+  with a call to Fl::check() before each one.
+
+  Recording is suspended during the replay.
+
+  \param[in] filename the file to read, in UTF-8
+  \param[in] speed replay speed, 0.0 for as fast as possible
+  \param[in] window an additional window to search, which need not be
+             shown, e.g. when running headless (see Fl_Headless)
+  \param[out] stats if not NULL, receives the frame times
+  \returns the number of events replayed, or -1 if the file could not
+           be read or is not an event recording
+*/
+int Fl_Event_Recorder::replay(const char *filename, double speed,
+                              Fl_Window *window, Fl_Replay_Stats *stats) {
+  FILE *f = fl_fopen(filename, "rb");
+  if (!f) return -1;
+  unsigned char *data = 0;
+  size_t size = 0, alloc = 0, n;
+  do {
+    if (size == alloc) {
+      alloc = alloc ? 2 * alloc : 65536;
+      data = (unsigned char*)realloc(data, alloc);
+    }
+    n = fread(data + size, 1, alloc - size, f);
+    size += n;
+  } while (n > 0);
+  fclose(f);
+  if (size < 5 || memcmp(data, "FLEV", 4) || data[4] != FILE_VERSION) {
+    free(data);
+    return -1;
+  }
+
+  Fl_Replay_Stats s;
+  memset(&s, 0, sizeof(s));
+  Replay_Window *windows = 0;
+  int nwindows = 0;
+  char text[256];
+  char was_recording = fl_record_events;
+  fl_record_events = 0;
+
+  Event_Reader in;
+  in.p = data + 5;
+  in.end = data + size;
+  in.error = 0;
+  double start = fl_loop_stat_time(), t = 0.0;
+  while (in.p < in.end && !in.error) {
+    int type = *in.p++;
+    if (type == 'W') {
+      int id = (int)in.get_uint();
+      in.get_uint(); in.get_uint();	// w and h are informational
+      Replay_Window r;
+      r.window = 0;
+      r.label = in.get_string(r.length);
+      if (in.error || id != nwindows + 1) break;
+      windows = (Replay_Window*)realloc(windows, id * sizeof(Replay_Window));
+      windows[nwindows++] = r;
+      continue;
+    }
+    if (type != 'E') break;
+    t += in.get_uint() / 1000000.0;
+    int e = (int)in.get_uint();
+    int id = (int)in.get_uint();
+    int x = (int)in.get_int(), y = (int)in.get_int();
+    int state = (int)in.get_uint();
+    int keysym = (int)in.get_uint(), original_keysym = (int)in.get_uint();
+    int dx = (int)in.get_int(), dy = (int)in.get_int();
+    int clicks = (int)in.get_int();
+    int is_click = (int)in.get_uint();
+    int length;
+    const char *s_text = in.get_string(length);
+    if (in.error) break;
+
+    if (speed > 0.0) {
+      double target = start + t / speed;
+      for (;;) {
+        double left = target - fl_loop_stat_time();
+        if (left <= 0.0) break;
+        Fl::wait(left);
+      }
+    } else {
+      Fl::check();
+    }
+
+    Fl_Window *w = find_window(windows, nwindows, id, window);
+    if (!w) {s.skipped++; continue;}
+    Fl::e_x = x;
+    Fl::e_y = y;
+    Fl::e_x_root = x + w->x_root();
+    Fl::e_y_root = y + w->y_root();
+    Fl::e_state = state;
+    Fl::e_keysym = keysym;
+    Fl::e_original_keysym = original_keysym;
+    Fl::e_dx = dx;
+    Fl::e_dy = dy;
+    Fl::e_clicks = clicks;
+    Fl::e_is_click = is_click;
+    // Fl::handle() may change the text, so it must be a copy:
+    if (length >= (int)sizeof(text)) length = sizeof(text) - 1;
+    memcpy(text, s_text, length);
+    text[length] = 0;
+    Fl::e_text = text;
+    Fl::e_length = length;
+    double t0 = fl_loop_stat_time();
+    Fl::handle(e, w);
+    Fl::flush();
+    fl_loop_stat_count(s.events, s.total, s.max, s.histogram, fl_loop_stat_time() - t0);
+  }
+  s.duration = fl_loop_stat_time() - start;
+
+  fl_record_events = was_recording;
+  free(windows);
+  free(data);
+  if (stats) *stats = s;
+  return (int)s.events;
+}
+
+/**
+  Writes a report of the frame times of a replay.
+
+  \param[in] stats frame times returned by replay()
+  \param[in] filename file to write, or NULL to write to stderr
+*/
+void Fl_Event_Recorder::print_replay_stats(const Fl_Replay_Stats &stats, const char *filename) {
+  FILE *f = filename ? fl_fopen(filename, "w") : stderr;
+  if (!f) return;
+  fprintf(f, "FLTK event replay (times in microseconds):\n");
+  fprintf(f, "events %lu, skipped %lu, duration %.0f\n",
+          stats.events, stats.skipped, stats.duration * 1000000.0);
+  fprintf(f, "frames: total %.0f, mean %.1f, max %.0f\n", stats.total * 1000000.0,
+          stats.events ? stats.total * 1000000.0 / stats.events : 0.0,
+          stats.max * 1000000.0);
+  fprintf(f, "histogram:");
+  fl_loop_stat_print_histogram(f, stats.histogram);
+  fprintf(f, "\n");
+  if (f != stderr) fclose(f);
+}
+
+static void stop_at_exit() {
+  Fl_Event_Recorder::stop();
+}
+
+static char read_environment() {
+  const char *name = fl_getenv("FLTK_RECORD_EVENTS");
+  if (!name || !*name) return 0;
+  if (Fl_Event_Recorder::start(name)) return 0;
+  atexit(stop_at_exit);
+  return 1;
+}
+
+//
+// End of "$Id$".
+//
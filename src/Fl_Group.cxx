@@ -24,9 +24,13 @@
 #include <stdio.h>
 #include <FL/Fl.H>
 #include <FL/Fl_Group.H>
+#include <FL/Fl_Widget_Arena.H>
 #include <FL/Fl_Window.H>
 #include <FL/fl_draw.H>
+#include <FL/math.h>
 #include <stdlib.h>
+#include "flstring.h"
+#include "Fl_Shortcut_Index.H"
 
 #include <FL/Fl_Input_Choice.H>
 #include <FL/Fl_Spinner.H>
@@ -37,21 +41,73 @@ Fl_Group* Fl_Group::current_;
 // Hack: A single child is stored in the pointer to the array, while
 // multiple children are stored in an allocated array:
 
+// With FLTK_ABI_VERSION 10304 or higher remove() sets the entry of the
+// child to NULL instead of moving down the later children. The holes
+// at the start of the array are skipped, the ones at the end are cut
+// off, and the others are closed by array() at the next access by index.
+// child_index_ is the position in array_, including the holes.
+
 /**
   Returns a pointer to the array of children. <I>This pointer is only
   valid until the next time a child is added or removed.</I>
 */
 Fl_Widget*const* Fl_Group::array() const {
+#if FLTK_ABI_VERSION >= 10304
+  if (holes_ > first_) ((Fl_Group*)this)->compact_array(0);
+  if (first_) return array_ + first_;
+#endif
   return children_ <= 1 ? (Fl_Widget**)(&array_) : array_;
 }
 
+#if FLTK_ABI_VERSION >= 10304
+
+// Closes the holes left by remove() in array_, except for those at the
+// start, unless all is set. The children before the first hole are not
+// moved then. With less than two children the array is freed and array_
+// is the only child:
+void Fl_Group::compact_array(int all) {
+  if (children_ <= 1) all = 1;
+  int n = children_ + holes_, i = first_, j = 0;
+  if (all) first_ = 0;
+  else {while (array_[i]) i++; j = i;}
+  for (; i < n; i++) {
+    Fl_Widget *o = array_[i];
+    if (!o) continue;
+    o->child_index_ = j;
+    array_[j++] = o;
+  }
+  holes_ = first_;
+  if (children_ <= 1) {
+    Fl_Widget *t = children_ ? array_[0] : 0;
+    free((void*)array_);
+    array_ = (Fl_Widget**)t;
+    alloc_ = 0;
+  }
+}
+
+#endif // FLTK_ABI_VERSION >= 10304
+
 /**
   Searches the child array for the widget and returns the index. Returns children()
   if the widget is NULL or not found.
+
+  With FLTK_ABI_VERSION 10304 or higher every widget remembers its position
+  in the array, so this does not need to search the array, unless the
+  children were rearranged without using insert() or remove().
 */
 int Fl_Group::find(const Fl_Widget* o) const {
   Fl_Widget*const* a = array();
+#if FLTK_ABI_VERSION >= 10304
+  // try the position the widget had when it was added or last found:
+  if (o) {
+    int i = o->child_index_ - first_;
+    if (i >= 0 && i < children_ && a[i] == o) return i;
+  }
+#endif
   int i; for (i=0; i < children_; i++) if (*a++ == o) break;
+#if FLTK_ABI_VERSION >= 10304
+  if (i < children_) ((Fl_Widget*)o)->child_index_ = i + first_;
+#endif
   return i;
 }
 
@@ -144,11 +200,379 @@ static int navkey() {
   return 0;
 }
 
+////////////////////////////////////////////////////////////////
+// Spatial index of the children
+//
+// A uniform grid over the bounding box of the children. The indices of
+// the children overlapping each cell are stored in ascending order in
+// one array (items), with the offset of each cell's list in another
+// (start). Children covering many cells, and children with a label
+// outside of their box (which may be drawn anywhere in the group), are
+// kept in a separate list (big) that is part of every result. The grid
+// is rebuilt on the next query after children were added, removed or
+// resized, so that moving many children costs one rebuild.
+//
+// The index also remembers the first few children that called damage()
+// since the group was last drawn, so that draw_children() can update
+// just those instead of looking at every child.
+
+#define FL_MAX_DAMAGED 32
+
+struct Fl_Group_Index {
+  int dirty;		// rebuild before the next query
+  int x, y, r, b;	// bounding box of the children
+  int cw, ch;		// cell size
+  int nx, ny;		// number of cells
+  int *start;		// nx*ny+1 offsets into items
+  int *items;		// child indices of all cells
+  int *big, nbig;	// child indices that are in every result
+  unsigned *mark;	// stamp of the last query that found a child
+  unsigned stamp;
+  int nmark;
+  Fl_Widget *damaged[FL_MAX_DAMAGED]; // children damaged since the last draw
+  int ndamaged;		// -1 if any child may be damaged
+  Fl_Group_Index() {
+    dirty = 1;
+    ndamaged = -1;
+    x = y = r = b = cw = ch = nx = ny = nbig = nmark = 0;
+    start = items = big = 0;
+    mark = 0;
+    stamp = 0;
+  }
+  ~Fl_Group_Index() {
+    free(start); free(items); free(big); free(mark);
+  }
+  void cells(const Fl_Widget *o, int &cx0, int &cy0, int &cx1, int &cy1) const;
+  void rebuild(const Fl_Group *g);
+  int is_big(int i) const;
+  void at(const Fl_Group *g, int X, int Y, class Fl_Child_List &list);
+  void inside(const Fl_Group *g, int X, int Y, int W, int H, Fl_Child_List &list);
+};
+
+// A list of child indices, in the order they must be visited.
+class Fl_Child_List {
+  int buf_[64];
+  int *p_, n_, size_;
+public:
+  Fl_Child_List() : p_(buf_), n_(0), size_(64) {}
+  ~Fl_Child_List() {if (p_ != buf_) free(p_);}
+  void add(int i) {
+    if (n_ >= size_) {
+      int *p = (int*)malloc(2 * size_ * sizeof(int));
+      memcpy(p, p_, n_ * sizeof(int));
+      if (p_ != buf_) free(p_);
+      p_ = p;
+      size_ *= 2;
+    }
+    p_[n_++] = i;
+  }
+  int size() const {return n_;}
+  int operator[](int k) const {return p_[k];}
+  int *data() {return p_;}
+};
+
+// Children that draw a label outside of their box:
+static int outside_label(Fl_Widget *o) {
+  return (o->align() & 15) && !(o->align() & FL_ALIGN_INSIDE) &&
+         (o->label() || o->image());
+}
+
+// Returns the range of cells a child overlaps.
+void Fl_Group_Index::cells(const Fl_Widget *o, int &cx0, int &cy0, int &cx1, int &cy1) const {
+  cx0 = (o->x() - x) / cw;
+  cy0 = (o->y() - y) / ch;
+  cx1 = (o->x() + o->w() - 1 - x) / cw;
+  cy1 = (o->y() + o->h() - 1 - y) / ch;
+  if (cx1 >= nx) cx1 = nx - 1;
+  if (cy1 >= ny) cy1 = ny - 1;
+}
+
+void Fl_Group_Index::rebuild(const Fl_Group *g) {
+  dirty = 0;
+  free(start); free(items); free(big);
+  start = items = big = 0;
+  nx = ny = nbig = 0;
+  int n = g->children();
+  if (!n) return;
+  Fl_Widget*const* a = g->array();
+  int i;
+  x = a[0]->x(); y = a[0]->y();
+  r = x + a[0]->w(); b = y + a[0]->h();
+  for (i = 1; i < n; i++) {
+    Fl_Widget *o = a[i];
+    if (o->x() < x) x = o->x();
+    if (o->y() < y) y = o->y();
+    if (o->x() + o->w() > r) r = o->x() + o->w();
+    if (o->y() + o->h() > b) b = o->y() + o->h();
+  }
+  // aim at about two children per cell:
+  double s = sqrt(double(r - x) * double(b - y) / (n / 2 + 1));
+  cw = ch = s < 1.0 ? 1 : (int)ceil(s);
+  nx = (r - x) / cw + 1;
+  ny = (b - y) / ch + 1;
+  int ncells = nx * ny;
+  start = (int*)calloc(ncells + 1, sizeof(int));
+  big = (int*)malloc(n * sizeof(int));
+  int cx0, cy0, cx1, cy1, cx, cy;
+  for (i = 0; i < n; i++) {
+    Fl_Widget *o = a[i];
+    cells(o, cx0, cy0, cx1, cy1);
+    if ((cx1 - cx0 + 1) * (cy1 - cy0 + 1) > 16 || outside_label(o)) {
+      big[nbig++] = i;
+      continue;
+    }
+    for (cy = cy0; cy <= cy1; cy++)
+      for (cx = cx0; cx <= cx1; cx++) start[cy * nx + cx + 1]++;
+  }
+  for (i = 0; i < ncells; i++) start[i + 1] += start[i];
+  items = (int*)malloc((start[ncells] + 1) * sizeof(int));
+  int *fill = (int*)malloc(ncells * sizeof(int));
+  memcpy(fill, start, ncells * sizeof(int));
+  for (i = 0, cx = 0; i < n; i++) {
+    if (cx < nbig && big[cx] == i) {cx++; continue;}
+    cells(a[i], cx0, cy0, cx1, cy1);
+    for (cy = cy0; cy <= cy1; cy++)
+      for (int c = cx0; c <= cx1; c++) items[fill[cy * nx + c]++] = i;
+  }
+  free(fill);
+}
+
+// Returns non-zero if child i is in every result.
+int Fl_Group_Index::is_big(int i) const {
+  int a = 0, c = nbig;
+  while (a < c) {
+    int m = (a + c) / 2;
+    if (big[m] == i) return 1;
+    if (big[m] < i) a = m + 1; else c = m;
+  }
+  return 0;
+}
+
+// Returns the children that may contain X,Y, topmost (last) first.
+void Fl_Group_Index::at(const Fl_Group *g, int X, int Y, Fl_Child_List &list) {
+  if (dirty) rebuild(g);
+  int *p = 0, np = 0;
+  if (nx && X >= x && X < r && Y >= y && Y < b) {
+    int c = ((Y - y) / ch) * nx + (X - x) / cw;
+    p = items + start[c];
+    np = start[c + 1] - start[c];
+  }
+  // merge the cell with the big children, both are sorted:
+  int j = nbig;
+  while (np || j) {
+    if (np && (!j || p[np - 1] > big[j - 1])) list.add(p[--np]);
+    else list.add(big[--j]);
+  }
+}
+
+static int compare_ints(const void *a, const void *b) {
+  return *(const int*)a - *(const int*)b;
+}
+
+// Returns the children that may overlap X,Y,W,H, bottom (first) first.
+void Fl_Group_Index::inside(const Fl_Group *g, int X, int Y, int W, int H, Fl_Child_List &list) {
+  if (dirty) rebuild(g);
+  int n = g->children(), i;
+  if (nmark < n) {
+    free(mark);
+    mark = (unsigned*)calloc(n, sizeof(unsigned));
+    nmark = n;
+    stamp = 0;
+  }
+  if (!++stamp) {	// wrapped around
+    memset(mark, 0, nmark * sizeof(unsigned));
+    stamp = 1;
+  }
+  for (i = 0; i < nbig; i++) {mark[big[i]] = stamp; list.add(big[i]);}
+  if (nx && W > 0 && H > 0 && X < r && Y < b && X + W > x && Y + H > y) {
+    int cx0 = X > x ? (X - x) / cw : 0;
+    int cy0 = Y > y ? (Y - y) / ch : 0;
+    int cx1 = (X + W - 1 - x) / cw; if (cx1 >= nx) cx1 = nx - 1;
+    int cy1 = (Y + H - 1 - y) / ch; if (cy1 >= ny) cy1 = ny - 1;
+    for (int cy = cy0; cy <= cy1; cy++)
+      for (int cx = cx0; cx <= cx1; cx++) {
+        int c = cy * nx + cx;
+        for (int k = start[c]; k < start[c + 1]; k++) {
+          i = items[k];
+          if (mark[i] != stamp) {mark[i] = stamp; list.add(i);}
+        }
+      }
+  }
+  qsort(list.data(), list.size(), sizeof(int), compare_ints);
+}
+
+// Returns the children that may be below the mouse, topmost first.
+static void children_at(const Fl_Group *g, Fl_Group_Index *index, Fl_Child_List &list) {
+  if (index) index->at(g, Fl::event_x(), Fl::event_y(), list);
+  else for (int i = g->children(); i--;) list.add(i);
+}
+
+// Returns the children that may overlap the current clip region, in
+// drawing order. Returns 0 if all children must be visited, because
+// there is no index or the clip region contains all children anyway.
+static int children_in_clip(const Fl_Group *g, Fl_Group_Index *index, Fl_Child_List &list) {
+  if (!index) return 0;
+  if (index->dirty) index->rebuild(g);
+  if (!index->nx) return 0;
+  int X, Y, W, H;
+  if (!fl_clip_box(index->x, index->y, index->r - index->x, index->b - index->y,
+                   X, Y, W, H)) return 0;
+  index->inside(g, X, Y, W, H, list);
+  return 1;
+}
+
+// Returns the children that may use the current keystroke as a
+// shortcut, in the order of the array. Returns 0 if all children must
+// get it, because the window has no shortcut index.
+static int shortcut_children(const Fl_Group *g, Fl_Child_List &list) {
+  const Fl_Shortcut_Index::Pair *p;
+  int n;
+  if (!Fl_Shortcut_Index::children(g, p, n)) return 0;
+  for (int k = 0; k < n; k++) list.add(p[k].pos);
+  return 1;
+}
+
+////////////////////////////////////////////////////////////////
+// Deferred layout:
+
+// A group that was resized, but whose children were not moved yet:
+struct Fl_Layout_Pending {
+  Fl_Group *group;
+  int x, y;	// position of the group that the children fit
+  int resized;	// the size of the group changed, too
+};
+
+static Fl_Layout_Pending *pending;
+static int npending, apending;
+static char defer_layout;
+static int layout_depth;	// non-zero while groups are laid out
+static unsigned long layout_requests, layout_passes;
+
+static int find_pending(const Fl_Group *g) {
+  int k = npending;
+  while (k-- && pending[k].group != g) {}
+  return k;
+}
+
+static void add_pending(Fl_Group *g, int resized) {
+  if (npending >= apending) {
+    apending = apending ? 2 * apending : 16;
+    pending = (Fl_Layout_Pending*)realloc((void*)pending, apending * sizeof(Fl_Layout_Pending));
+  }
+  pending[npending].group = g;
+  pending[npending].x = g->x();
+  pending[npending].y = g->y();
+  pending[npending].resized = resized;
+  npending++;
+}
+
+/**
+  Turns deferred layout on or off.
+
+  Normally Fl_Group::resize() moves and resizes all children of the group
+  right away, and so do the children that are groups. A window that is
+  resized interactively, or a program that resizes groups in a loop,
+  may do this many times before anything is drawn.
+
+  With deferred layout, resize() only changes the size of the group and
+  remembers that its children must be placed. This is done once, from
+  the outermost group down, before the next event is handled or the
+  windows are drawn by Fl::flush(), or when layout() is called. Reading
+  the position of a child right after resizing its parent returns the
+  old position, call Fl_Group::layout() or Fl::layout() first if you
+  need the new one.
+
+  Deferred layout is off by default. Turning it off places all children
+  whose layout is pending.
+
+  \see Fl::layout_counts()
+*/
+void Fl::deferred_layout(int on) {
+  defer_layout = on ? 1 : 0;
+  if (!on) layout();
+}
+
+/**
+  Returns non-zero if the layout of groups is deferred.
+  \see Fl::deferred_layout(int)
+*/
+int Fl::deferred_layout() {
+  return defer_layout;
+}
+
+/**
+  Places the children of all groups that were resized since the last
+  layout. This is called by Fl::flush(), by Fl_Headless_Surface::draw()
+  and before each event is handled.
+  \see Fl::deferred_layout(int)
+*/
+void Fl::layout() {
+  if (!npending || layout_depth) return;
+  layout_passes++;
+  while (npending) pending[npending - 1].group->layout();
+}
+
+/**
+  Returns how many resize() calls of groups were deferred, and how many
+  layout passes placed the children. The difference shows how many times
+  the layout of a group was saved.
+  \see Fl::deferred_layout(int)
+*/
+void Fl::layout_counts(unsigned long &requests, unsigned long &passes) {
+  requests = layout_requests;
+  passes = layout_passes;
+}
+
+/**
+  Moves and resizes the children to fit the group, if the group was
+  resized while Fl::deferred_layout() is on and its children were not
+  placed yet. Groups around this one whose layout is pending are laid
+  out first.
+*/
+void Fl_Group::layout() {
+  while (flags() & LAYOUT_PENDING) {
+    Fl_Group *g = this;
+    for (Fl_Group *p = parent(); p; p = p->parent())
+      if (p->flags() & LAYOUT_PENDING) g = p;
+    layout_depth++;
+    // subclasses like Fl_Table place their own widgets after Fl_Group::resize():
+    g->resize(g->x(), g->y(), g->w(), g->h());
+    if (g->flags() & LAYOUT_PENDING) g->Fl_Group::resize(g->x(), g->y(), g->w(), g->h());
+    layout_depth--;
+  }
+}
+
+// Returns the children that called damage() since the group was last
+// drawn, in drawing order, and forgets them. Returns 0 if they are not
+// known, because there is no index or too many children were damaged.
+static int damaged_children(const Fl_Group *g, Fl_Group_Index *index, Fl_Child_List &list) {
+  if (!index || index->ndamaged < 0) {
+    if (index) index->ndamaged = 0;
+    return 0;
+  }
+  for (int k = 0; k < index->ndamaged; k++) {
+    int i = g->find(index->damaged[k]);
+    if (i >= g->children()) continue;
+    int j = list.size();	// insertion sort, the list is short
+    list.add(i);
+    for (; j > 0 && list[j - 1] > i; j--) list.data()[j] = list[j - 1];
+    list.data()[j] = i;
+  }
+  index->ndamaged = 0;
+  return 1;
+}
+
 int Fl_Group::handle(int event) {
 
   Fl_Widget*const* a = array();
-  int i;
+  int i, k, listed;
   Fl_Widget* o;
+  Fl_Child_List hits;	// children below the mouse, topmost first
+#if FLTK_ABI_VERSION >= 10304
+  Fl_Group_Index *index = index_;
+#else
+  Fl_Group_Index *index = 0;
+#endif
 
   switch (event) {
 
@@ -175,13 +599,15 @@ int Fl_Group::handle(int event) {
     return navigation(navkey());
 
   case FL_SHORTCUT:
-    for (i = children(); i--;) {
-      o = a[i];
+    if (Fl_Shortcut_Index::collecting) return 0;
+    listed = shortcut_children(this, hits);
+    for (k = listed ? hits.size() : children(); k--;) {
+      o = a[listed ? hits[k] : k];
       if (o->takesevents() && Fl::event_inside(o) && send(o,FL_SHORTCUT))
 	return 1;
     }
-    for (i = children(); i--;) {
-      o = a[i];
+    for (k = listed ? hits.size() : children(); k--;) {
+      o = a[listed ? hits[k] : k];
       if (o->takesevents() && !Fl::event_inside(o) && send(o,FL_SHORTCUT))
 	return 1;
     }
@@ -190,8 +616,10 @@ int Fl_Group::handle(int event) {
 
   case FL_ENTER:
   case FL_MOVE:
-    for (i = children(); i--;) {
-      o = a[i];
+    children_at(this, index, hits);
+    for (k = 0; k < hits.size(); k++) {
+      if (hits[k] >= children()) continue;
+      o = child(hits[k]);
       if (o->visible() && Fl::event_inside(o)) {
 	if (o->contains(Fl::belowmouse())) {
 	  return send(o,FL_MOVE);
@@ -206,8 +634,10 @@ int Fl_Group::handle(int event) {
 
   case FL_DND_ENTER:
   case FL_DND_DRAG:
-    for (i = children(); i--;) {
-      o = a[i];
+    children_at(this, index, hits);
+    for (k = 0; k < hits.size(); k++) {
+      if (hits[k] >= children()) continue;
+      o = child(hits[k]);
       if (o->takesevents() && Fl::event_inside(o)) {
 	if (o->contains(Fl::belowmouse())) {
 	  return send(o,FL_DND_DRAG);
@@ -221,8 +651,10 @@ int Fl_Group::handle(int event) {
     return 0;
 
   case FL_PUSH:
-    for (i = children(); i--;) {
-      o = a[i];
+    children_at(this, index, hits);
+    for (k = 0; k < hits.size(); k++) {
+      if (hits[k] >= children()) continue;
+      o = child(hits[k]);
       if (o->takesevents() && Fl::event_inside(o)) {
 	Fl_Widget_Tracker wp(o);
 	if (send(o,FL_PUSH)) {
@@ -239,8 +671,10 @@ int Fl_Group::handle(int event) {
     if (o == this) return 0;
     else if (o) send(o,event);
     else {
-      for (i = children(); i--;) {
-	o = a[i];
+      children_at(this, index, hits);
+      for (k = 0; k < hits.size(); k++) {
+	if (hits[k] >= children()) continue;
+	o = child(hits[k]);
 	if (o->takesevents() && Fl::event_inside(o)) {
 	  if (send(o,event)) return 1;
 	}
@@ -249,8 +683,10 @@ int Fl_Group::handle(int event) {
     return 0;
 
   case FL_MOUSEWHEEL:
-    for (i = children(); i--;) {
-      o = a[i];
+    children_at(this, index, hits);
+    for (k = 0; k < hits.size(); k++) {
+      if (hits[k] >= children()) continue;
+      o = child(hits[k]);
       if (o->takesevents() && Fl::event_inside(o) && send(o,FL_MOUSEWHEEL))
 	return 1;
     }
@@ -317,12 +753,13 @@ const char *nameof(Fl_Widget *o) {
 // try to move the focus in response to a keystroke:
 int Fl_Group::navigation(int key) {
   if (children() <= 1) return 0;
+  Fl_Widget*const* a = array();
   int i;
   for (i = 0; ; i++) {
     if (i >= children_) return 0;
-    if (array_[i]->contains(Fl::focus())) break;
+    if (a[i]->contains(Fl::focus())) break;
   }
-  Fl_Widget *previous = array_[i];
+  Fl_Widget *previous = a[i];
 
   for (;;) {
     switch (key) {
@@ -345,7 +782,7 @@ int Fl_Group::navigation(int key) {
     default:
       return 0;
     }
-    Fl_Widget* o = array_[i];
+    Fl_Widget* o = a[i];
     if (o == previous) return 0;
     switch (key) {
     case FL_Down:
@@ -368,6 +805,11 @@ Fl_Group::Fl_Group(int X,int Y,int W,int H,const char *l)
   savedfocus_ = 0;
   resizable_ = this;
   sizes_ = 0; // this is allocated when first resize() is done
+#if FLTK_ABI_VERSION >= 10304
+  index_ = 0;
+  alloc_ = 0;
+  holes_ = first_ = 0;
+#endif
   // Subclasses may want to construct child objects as part of their
   // constructor, so make sure they are add()'d to this object.
   // But you must end() the object!
@@ -381,6 +823,7 @@ Fl_Group::Fl_Group(int X,int Y,int W,int H,const char *l)
   affects all child widgets and deletes them from memory.
 */
 void Fl_Group::clear() {
+  layout();
   savedfocus_ = 0;
   resizable_ = this;
   init_sizes();
@@ -400,6 +843,9 @@ void Fl_Group::clear() {
 #ifdef  REVERSE_CHILDREN
   // Reverse the order of the children. Doing this and deleting
   // always the last child is much faster than the other way around.
+#if FLTK_ABI_VERSION >= 10304
+  if (holes_) compact_array(1);
+#endif
   if (children_ > 1) {
     Fl_Widget *temp;
     Fl_Widget **a = (Fl_Widget**)array();
@@ -407,6 +853,10 @@ void Fl_Group::clear() {
       temp = a[i];
       a[i] = a[j];
       a[j] = temp;
+#if FLTK_ABI_VERSION >= 10304
+      a[i]->child_index_ = i;
+      a[j]->child_index_ = j;
+#endif
     }
   }
 #endif // REVERSE_CHILDREN
@@ -421,13 +871,17 @@ void Fl_Group::clear() {
       } else {				// slow removal
         remove(idx);
       }
-      delete w;				// delete the child
+      Fl_Widget_Arena::destroy(w);	// delete the child
     } else {				// should never happen
       remove(idx);			// remove it anyway
     }
   }
 
   if (pushed != this) Fl::pushed(pushed); // reset pushed() widget
+  shortcuts_changed();
+#if FLTK_ABI_VERSION >= 10304
+  if (index_) index_->ndamaged = 0;	// they were all deleted
+#endif
 
 }
 
@@ -446,7 +900,15 @@ void Fl_Group::clear() {
   widgets' destructors would be called twice!
 */
 Fl_Group::~Fl_Group() {
+  if (flags() & LAYOUT_PENDING) {
+    int k = find_pending(this);
+    pending[k] = pending[--npending];
+  }
   clear();
+#if FLTK_ABI_VERSION >= 10304
+  delete index_;
+#endif
+  if (flags() & ARENA_OWNER) arena()->owner_deleted();
 }
 
 /**
@@ -456,6 +918,7 @@ Fl_Group::~Fl_Group() {
   the widgets inside a group.
 */
 void Fl_Group::insert(Fl_Widget &o, int index) {
+  layout();
   if (o.parent()) {
     Fl_Group* g = o.parent();
     int n = g->find(o);
@@ -466,24 +929,146 @@ void Fl_Group::insert(Fl_Widget &o, int index) {
     g->remove(n);
   }
   o.parent_ = this;
+  if (index > children_) index = children_;
   if (children_ == 0) { // use array pointer to point at single child
     array_ = (Fl_Widget**)&o;
-  } else if (children_ == 1) { // go from 1 to 2 children
-    Fl_Widget* t = (Fl_Widget*)array_;
-    array_ = (Fl_Widget**)malloc(2*sizeof(Fl_Widget*));
-    if (index) {array_[0] = t; array_[1] = &o;}
-    else {array_[0] = &o; array_[1] = t;}
+#if FLTK_ABI_VERSION >= 10304
+    o.child_index_ = 0;
+#endif
   } else {
-    if (!(children_ & (children_-1))) // double number of children
-      array_ = (Fl_Widget**)realloc((void*)array_,
-				    2*children_*sizeof(Fl_Widget*));
-    int j; for (j = children_; j > index; j--) array_[j] = array_[j-1];
+    grow_array(children_+1);
+    int j = children_;
+#if FLTK_ABI_VERSION >= 10304
+    // a child is appended after the holes, otherwise they are closed
+    // first, except for those at the start, which are as many as holes_:
+    if (index < children_) array();
+    index += holes_;
+    j += holes_;
+#endif
+    for (; j > index; j--) {
+      array_[j] = array_[j-1];
+#if FLTK_ABI_VERSION >= 10304
+      array_[j]->child_index_ = j;
+#endif
+    }
     array_[j] = &o;
+#if FLTK_ABI_VERSION >= 10304
+    o.child_index_ = j;
+#endif
   }
   children_++;
   init_sizes();
+  shortcuts_changed();
+#if FLTK_ABI_VERSION >= 10304
+  child_changed(&o, CHILD_ADDED);
+#endif
+}
+
+// Makes room in array_ for n children, n > 1. If the group has less
+// than two children, array_ is the only child or NULL, and it becomes
+// the first entry of the new array. The caller must then add children
+// so that there are at least two.
+void Fl_Group::grow_array(int n) {
+  int room = 0; // entries allocated in array_
+#if FLTK_ABI_VERSION >= 10304
+  if (children_ > 1) room = alloc_;
+  // the holes left by remove() take room too, unless they are closed
+  // because they are at least half of the array:
+  if (holes_ && holes_ >= children_) compact_array(1);
+  n += holes_;
+  int size = room ? room : (alloc_ > 2 ? alloc_ : 2);
+#else
+  // the array is reallocated whenever children_ reaches a power of 2:
+  if (children_ > 1) for (room = 2; room < children_; room *= 2) {}
+  int size = room ? room : 2;
+#endif
+  if (n <= room) return;
+  while (size < n) size *= 2;
+  if (room) {
+    array_ = (Fl_Widget**)realloc((void*)array_, size*sizeof(Fl_Widget*));
+  } else { // go from 0 or 1 child to an array
+    Fl_Widget* t = (Fl_Widget*)array_;
+    array_ = (Fl_Widget**)malloc(size*sizeof(Fl_Widget*));
+    if (children_) array_[0] = t;
+  }
+#if FLTK_ABI_VERSION >= 10304
+  alloc_ = size;
+#endif
 }
 
+/**
+  Adds many widgets to the end of the group at once.
+
+  This does the same as calling add() for each widget in \p widgets,
+  but the array of children is resized only once, and the remembered
+  sizes of the children (see init_sizes()) are reset only once. This
+  makes a difference when many thousands of widgets are added to a
+  group.
+
+  Widgets that are children of another group are removed from it first.
+  NULL pointers in \p widgets are ignored, and the same widget must not
+  appear twice.
+
+  \param[in] widgets array of widgets to add
+  \param[in] n number of widgets in \p widgets
+
+  \see reserve()
+*/
+void Fl_Group::add_bulk(Fl_Widget* const* widgets, int n) {
+  int i, count = 0;
+  layout();
+  for (i = 0; i < n; i++) {
+    Fl_Widget *o = widgets[i];
+    if (!o) continue;
+    if (o->parent()) o->parent()->remove(*o);
+    count++;
+  }
+  if (!count) return;
+  if (children_ + count == 1) { // only one child, no array needed
+    for (i = 0; !widgets[i]; i++) {}
+    insert(*widgets[i], 0);
+    return;
+  }
+  grow_array(children_ + count);
+  Fl_Widget **a = array_;
+#if FLTK_ABI_VERSION >= 10304
+  a += holes_;	// append after the holes left by remove()
+#endif
+  for (i = 0; i < n; i++) {
+    Fl_Widget *o = widgets[i];
+    if (!o) continue;
+    o->parent_ = this;
+#if FLTK_ABI_VERSION >= 10304
+    o->child_index_ = children_ + holes_;
+#endif
+    a[children_++] = o;
+  }
+  init_sizes();
+  shortcuts_changed();
+#if FLTK_ABI_VERSION >= 10304
+  for (i = 0; i < n; i++) if (widgets[i]) child_changed(widgets[i], CHILD_ADDED);
+#endif
+}
+
+#if FLTK_ABI_VERSION >= 10304
+
+/**
+  Makes room for \p n children without reallocating the array of children.
+
+  Call this before adding a known, large number of children with add(),
+  insert() or add_bulk(). The room is kept when children are removed,
+  until the group has less than two children.
+
+  \note Availability in FLTK_ABI_VERSION 10304 or higher.
+*/
+void Fl_Group::reserve(int n) {
+  if (n < 2) return;
+  if (children_ > 1) grow_array(n);
+  else if (n > alloc_) alloc_ = n; // used when the array is allocated
+}
+
+#endif // FLTK_ABI_VERSION >= 10304
+
 /**
   The widget is removed from its current group (if any) and then added
   to the end of this group.
@@ -497,12 +1082,29 @@ void Fl_Group::add(Fl_Widget &o) {insert(o, children_);}
 
   This method differs from the clear() method in that it only affects
   a single widget and does not delete it from memory.
+
+  With FLTK_ABI_VERSION 10304 or higher the later children are not moved
+  down in the array of children. Their move is deferred until they are
+  next accessed by index, with array(), child() or find(), so that many
+  children can be removed at the cost of one move. Removing the first
+  or the last child never moves the others.
   
   \since FLTK 1.3.0
 */
 void Fl_Group::remove(int index) {
   if (index < 0 || index >= children_) return;
-  Fl_Widget &o = *child(index);
+  layout();
+#if FLTK_ABI_VERSION >= 10304
+  if (children_ > 1) array();	// close the holes after the first child
+  index += first_;
+#endif
+  remove_slot(index);
+}
+
+// Removes the child in array_[i]. Without holes in the array, i is the
+// index of the child:
+void Fl_Group::remove_slot(int i) {
+  Fl_Widget &o = children_ > 1 ? *array_[i] : *(Fl_Widget*)array_;
   if (&o == savedfocus_) savedfocus_ = 0;
   if (o.parent_ == this) {	// this should always be true
     o.parent_ = 0;
@@ -511,14 +1113,29 @@ void Fl_Group::remove(int index) {
   // remove the widget from the group
 
   children_--;
+#if FLTK_ABI_VERSION >= 10304
+  if (children_) { // leave a hole in the array
+    array_[i] = 0;
+    holes_++;
+    int n = children_ + holes_;
+    if (i == first_) while (!array_[first_]) first_++;
+    if (i == n-1) while (!array_[n-1]) {n--; holes_--;}
+    if (children_ == 1) compact_array(1); // go from 2 to 1 child
+  }
+#else
   if (children_ == 1) { // go from 2 to 1 child
-    Fl_Widget *t = array_[!index];
+    Fl_Widget *t = array_[!i];
     free((void*)array_);
     array_ = (Fl_Widget**)t;
   } else if (children_ > 1) { // delete from array
-    for (; index < children_; index++) array_[index] = array_[index+1];
+    for (; i < children_; i++) array_[i] = array_[i+1];
   }
+#endif
   init_sizes();
+  shortcuts_changed();
+#if FLTK_ABI_VERSION >= 10304
+  child_changed(&o, CHILD_REMOVED);
+#endif
 }
 
 /**
@@ -536,6 +1153,15 @@ void Fl_Group::remove(int index) {
 */
 void Fl_Group::remove(Fl_Widget &o) {
   if (!children_) return;
+#if FLTK_ABI_VERSION >= 10304
+  // use the remembered position, which keeps the holes in the array:
+  layout();
+  int k = o.child_index_;
+  if (children_ > 1 && k >= first_ && k < children_ + holes_ && array_[k] == &o) {
+    remove_slot(k);
+    return;
+  }
+#endif
   int i = find(o);
   if (i < children_) remove(i);
 }
@@ -570,9 +1196,94 @@ void Fl_Group::remove(Fl_Widget &o) {
   \sa sizes()
 */
 void Fl_Group::init_sizes() {
+  layout();
   delete[] sizes_; sizes_ = 0;
+#if FLTK_ABI_VERSION >= 10304
+  if (index_) index_->dirty = 1;
+#endif
 }
 
+#if FLTK_ABI_VERSION >= 10304
+
+/**
+  Turns the spatial index of the children on or off.
+
+  Events at the mouse position, i.e. FL_PUSH, FL_RELEASE, FL_DRAG,
+  FL_ENTER, FL_MOVE, FL_DND_ENTER, FL_DND_DRAG and FL_MOUSEWHEEL,
+  are normally offered to each child in turn, from the last to the
+  first, until one that contains the mouse takes the event. A group
+  with the index only offers them to the children near the mouse, in
+  the same order. This makes a big difference for groups with many
+  thousands of children, and costs a little memory and time for
+  smaller groups.
+
+  The index is also used by draw_children(). When only some children
+  need to be redrawn, e.g. for a blinking cursor and a highlighted
+  button, the group remembers which ones called damage() and only
+  visits those. If too many children were damaged, or the group was
+  given FL_DAMAGE_CHILD directly, only the children overlapping the
+  clip region are visited. When the whole group is redrawn, e.g.
+  after an expose, the same culling by the clip region is used.
+
+  The index is updated when children are added, removed or resized, or
+  when their label, its alignment, size or image is changed. If you move
+  children without calling their resize() method, call init_sizes()
+  afterwards.
+
+  \note Availability in FLTK_ABI_VERSION 10304 or higher.
+*/
+void Fl_Group::spatial_index(int on) {
+  if (on && !index_) index_ = new Fl_Group_Index;
+  else if (!on && index_) {delete index_; index_ = 0;}
+}
+
+/**
+  Returns non-zero if the group uses a spatial index of its children.
+  \see spatial_index(int)
+*/
+int Fl_Group::spatial_index() const {
+  return index_ != 0;
+}
+
+/**
+  Called after a child was resized, added to or removed from the group,
+  or after its label changed.
+
+  \p what is CHILD_RESIZED, CHILD_ADDED, CHILD_REMOVED or CHILD_LABEL.
+  Groups that keep information about the positions of their children can
+  override this to update it, and must call the base class method.
+
+  \note Availability in FLTK_ABI_VERSION 10304 or higher.
+*/
+void Fl_Group::child_changed(Fl_Widget *o, int what) {
+  if (!index_) return;
+  if (what == CHILD_LABEL) { // only a label that is not in every result
+    if (!index_->dirty && outside_label(o) && !index_->is_big(find(o)))
+      index_->dirty = 1;
+    return;
+  }
+  index_->dirty = 1;
+  if (what == CHILD_REMOVED) {	// forget it, it may be deleted next
+    for (int k = index_->ndamaged; k-- > 0;)
+      if (index_->damaged[k] == o) index_->damaged[k] = index_->damaged[--index_->ndamaged];
+  } else if (what == CHILD_ADDED && o->damage()) {
+    child_damaged(o);
+  }
+}
+
+// Called by Fl_Widget::damage() for a group with a spatial index. o is
+// the child that was damaged, or the group itself if it was given
+// FL_DAMAGE_CHILD directly, in which case any child may need drawing.
+void Fl_Group::child_damaged(Fl_Widget *o) {
+  Fl_Group_Index *index = index_;
+  if (index->ndamaged < 0) return;
+  if (o == this || index->ndamaged == FL_MAX_DAMAGED) {index->ndamaged = -1; return;}
+  for (int k = 0; k < index->ndamaged; k++) if (index->damaged[k] == o) return;
+  index->damaged[index->ndamaged++] = o;
+}
+
+#endif // FLTK_ABI_VERSION >= 10304
+
 /**
   Returns the internal array of widget sizes and positions.
 
@@ -633,16 +1344,40 @@ int* Fl_Group::sizes() {
 */
 void Fl_Group::resize(int X, int Y, int W, int H) {
 
+  if (parent() && (parent()->flags() & LAYOUT_PENDING)) parent()->layout();
+
   int dx = X-x();
   int dy = Y-y();
   int dw = W-w();
   int dh = H-h();
+  int resized = dw || dh;
   
   int *p = sizes(); // save initial sizes and positions
 
+  if (flags() & LAYOUT_PENDING) {
+    // the children still fit the position the group had before:
+    int k = find_pending(this);
+    dx = X - pending[k].x;
+    dy = Y - pending[k].y;
+    resized = pending[k].resized |= resized;
+    if (!layout_depth) {
+      layout_requests++;
+      Fl_Widget::resize(X,Y,W,H);
+      return;
+    }
+    pending[k] = pending[--npending];
+    clear_flag(LAYOUT_PENDING);
+  } else if (defer_layout && !layout_depth) {
+    add_pending(this, resized);
+    set_flag(LAYOUT_PENDING);
+    layout_requests++;
+    Fl_Widget::resize(X,Y,W,H);
+    return;
+  }
+
   Fl_Widget::resize(X,Y,W,H); // make new xywh values visible for children
 
-  if (!resizable() || (dw==0 && dh==0) ) {
+  if (!resizable() || !resized) {
 
     if (type() < FL_WINDOW) {
       Fl_Widget*const* a = array();
@@ -722,14 +1457,27 @@ void Fl_Group::draw_children() {
 		 h() - Fl::box_dh(box()));
   }
 
+#if FLTK_ABI_VERSION >= 10304
+  Fl_Group_Index *index = index_;
+#else
+  Fl_Group_Index *index = 0;
+#endif
+  Fl_Child_List visit;	// children that overlap the clip region
+  int culled;
   if (damage() & ~FL_DAMAGE_CHILD) { // redraw the entire thing:
-    for (int i=children_; i--;) {
-      Fl_Widget& o = **a++;
+    if (index) index->ndamaged = 0;
+    culled = children_in_clip(this, index, visit);
+    int n = culled ? visit.size() : children_;
+    for (int k = 0; k < n; k++) {
+      Fl_Widget& o = *a[culled ? visit[k] : k];
       draw_child(o);
       draw_outside_label(o);
     }
   } else {	// only redraw the children that need it:
-    for (int i=children_; i--;) update_child(**a++);
+    culled = damaged_children(this, index, visit);
+    if (!culled) culled = children_in_clip(this, index, visit);
+    int n = culled ? visit.size() : children_;
+    for (int k = 0; k < n; k++) update_child(*a[culled ? visit[k] : k]);
   }
 
   if (clip_children()) fl_pop_clip();
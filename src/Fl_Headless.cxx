@@ -0,0 +1,754 @@
+//
+// "$Id$"
+//
+// Headless operation for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2016 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// A software renderer drawing into memory, and functions that inject
+// events, so that widgets can be exercised without a display.
+
+#include <FL/Fl.H>
+#include <FL/Fl_Headless.H>
+#include <FL/Fl_Window.H>
+#include <FL/Fl_Image.H>
+#include <FL/Fl_Tooltip.H>
+#include <FL/fl_draw.H>
+#include <FL/math.h>
+#include "fl_loop_stats.h"
+#include "flstring.h"
+#include <stdlib.h>
+
+extern Fl_Window *fl_xfocus;	// which window X thinks has focus
+extern Fl_Window *fl_xmousewin;	// which window X thinks has the mouse
+
+char Fl_Headless::enabled_ = 0;
+
+const char *Fl_Headless_Graphics_Driver::class_id = "Fl_Headless_Graphics_Driver";
+const char *Fl_Headless_Surface::class_id = "Fl_Headless_Surface";
+
+////////////////////////////////////////////////////////////////
+// Fl_Headless_Graphics_Driver
+
+Fl_Headless_Graphics_Driver::Fl_Headless_Graphics_Driver() {
+  buf_ = 0;
+  w_ = h_ = 0;
+  ox_ = oy_ = 0;
+  r_ = g_ = b_ = 0;
+  clip_size_ = 16;
+  clip_ = (Clip*)malloc(clip_size_ * sizeof(Clip));
+  clip_n_ = 0;
+  clip_[0].x = clip_[0].y = clip_[0].r = clip_[0].b = 0;
+  calls_ = 0;
+}
+
+Fl_Headless_Graphics_Driver::~Fl_Headless_Graphics_Driver() {
+  free(clip_);
+  delete[] buf_;
+}
+
+// Sets a pixel to the current color. x and y are in pixels.
+void Fl_Headless_Graphics_Driver::pixel(int x, int y) {
+  const Clip &c = clip_[clip_n_];
+  if (x < c.x || x >= c.r || y < c.y || y >= c.b) return;
+  uchar *p = buf_ + (y * w_ + x) * 3;
+  p[0] = r_; p[1] = g_; p[2] = b_;
+}
+
+// Fills pixels x1 to x2 inclusive of line y. Coordinates are in pixels.
+void Fl_Headless_Graphics_Driver::span(int x1, int x2, int y) {
+  const Clip &c = clip_[clip_n_];
+  if (y < c.y || y >= c.b) return;
+  if (x1 > x2) {int t = x1; x1 = x2; x2 = t;}
+  if (x1 < c.x) x1 = c.x;
+  if (x2 >= c.r) x2 = c.r - 1;
+  for (uchar *p = buf_ + (y * w_ + x1) * 3; x1 <= x2; x1++, p += 3) {
+    p[0] = r_; p[1] = g_; p[2] = b_;
+  }
+}
+
+// Draws a line including both end points, coordinates are logical.
+void Fl_Headless_Graphics_Driver::draw_line(int x1, int y1, int x2, int y2) {
+  x1 += ox_; y1 += oy_; x2 += ox_; y2 += oy_;
+  if (y1 == y2) {span(x1, x2, y1); return;}
+  int dx = abs(x2 - x1), sx = x1 < x2 ? 1 : -1;
+  int dy = -abs(y2 - y1), sy = y1 < y2 ? 1 : -1;
+  int err = dx + dy;
+  for (;;) {
+    pixel(x1, y1);
+    if (x1 == x2 && y1 == y2) break;
+    int e2 = 2 * err;
+    if (e2 >= dy) {err += dy; x1 += sx;}
+    if (e2 <= dx) {err += dx; y1 += sy;}
+  }
+}
+
+// Fills a polygon given as n logical x,y pairs with the even-odd rule.
+// Pixels are filled if their center is inside, like XFillPolygon() does.
+void Fl_Headless_Graphics_Driver::fill_polygon(const int *xy, int n) {
+  if (n < 3) return;
+  int i, ymin = xy[1], ymax = xy[1];
+  for (i = 1; i < n; i++) {
+    if (xy[2*i+1] < ymin) ymin = xy[2*i+1];
+    if (xy[2*i+1] > ymax) ymax = xy[2*i+1];
+  }
+  double *cross = (double*)malloc(n * sizeof(double));
+  for (int y = ymin; y < ymax; y++) {
+    double sy = y + 0.5;
+    int nc = 0;
+    for (i = 0; i < n; i++) {
+      int j = (i + 1) % n;
+      double y0 = xy[2*i+1], y1 = xy[2*j+1];
+      if ((y0 <= sy) == (y1 <= sy)) continue;
+      cross[nc++] = xy[2*i] + (sy - y0) * (xy[2*j] - xy[2*i]) / (y1 - y0);
+    }
+    // few crossings per line, so an insertion sort is fine:
+    for (i = 1; i < nc; i++) {
+      double t = cross[i];
+      int j = i;
+      for (; j > 0 && cross[j-1] > t; j--) cross[j] = cross[j-1];
+      cross[j] = t;
+    }
+    for (i = 0; i + 1 < nc; i += 2) {
+      int x1 = (int)ceil(cross[i] - 0.5), x2 = (int)ceil(cross[i+1] - 0.5) - 1;
+      if (x1 <= x2) span(x1 + ox_, x2 + ox_, y + oy_);
+    }
+  }
+  free(cross);
+}
+
+// Draws or fills the part of the ellipse inside x,y,w,h from angle a1 to
+// a2, in degrees counter-clockwise from 3 o'clock, like XDrawArc() does.
+void Fl_Headless_Graphics_Driver::ellipse(int x, int y, int w, int h,
+                                          double a1, double a2, int fill) {
+  if (w <= 0 || h <= 0) return;
+  double rx = (w - 1) / 2.0, ry = (h - 1) / 2.0;
+  double cx = x + rx, cy = y + ry;
+  if (fill) {rx += 0.5; ry += 0.5; cx += 0.5; cy += 0.5;}
+  int segs = int((rx + ry) * fabs(a2 - a1) / 90.0) + 4;
+  if (segs > 1000) segs = 1000;
+  int *xy = (int*)malloc((segs + 2) * 2 * sizeof(int));
+  int n = 0;
+  for (int i = 0; i <= segs; i++, n++) {
+    double a = (a1 + (a2 - a1) * i / segs) * M_PI / 180.0;
+    xy[2*n] = (int)floor(cx + rx * cos(a) + (fill ? 0.0 : 0.5));
+    xy[2*n+1] = (int)floor(cy - ry * sin(a) + (fill ? 0.0 : 0.5));
+  }
+  if (fill) {
+    if (fabs(a2 - a1) < 360) {
+      xy[2*n] = (int)floor(cx); xy[2*n+1] = (int)floor(cy); n++;
+    }
+    fill_polygon(xy, n);
+  } else {
+    for (int i = 1; i < n; i++) draw_line(xy[2*i-2], xy[2*i-1], xy[2*i], xy[2*i+1]);
+  }
+  free(xy);
+}
+
+void Fl_Headless_Graphics_Driver::color(Fl_Color c) {
+  Fl_Graphics_Driver::color(c);
+  Fl::get_color(c, r_, g_, b_);
+}
+
+void Fl_Headless_Graphics_Driver::color(uchar r, uchar g, uchar b) {
+  Fl_Graphics_Driver::color(fl_rgb_color(r, g, b));
+  r_ = r; g_ = g; b_ = b;
+}
+
+void Fl_Headless_Graphics_Driver::rect(int x, int y, int w, int h) {
+  calls_++;
+  if (w <= 0 || h <= 0) return;
+  draw_line(x, y, x+w-1, y);
+  draw_line(x, y+h-1, x+w-1, y+h-1);
+  draw_line(x, y, x, y+h-1);
+  draw_line(x+w-1, y, x+w-1, y+h-1);
+}
+
+void Fl_Headless_Graphics_Driver::rectf(int x, int y, int w, int h) {
+  calls_++;
+  if (w <= 0 || h <= 0) return;
+  for (int i = 0; i < h; i++) span(x + ox_, x + w - 1 + ox_, y + i + oy_);
+}
+
+void Fl_Headless_Graphics_Driver::line_style(int style, int width, char* dashes) {
+  // lines are always solid and one pixel wide
+}
+
+void Fl_Headless_Graphics_Driver::xyline(int x, int y, int x1) {
+  calls_++;
+  draw_line(x, y, x1, y);
+}
+
+void Fl_Headless_Graphics_Driver::xyline(int x, int y, int x1, int y2) {
+  calls_++;
+  draw_line(x, y, x1, y);
+  draw_line(x1, y, x1, y2);
+}
+
+void Fl_Headless_Graphics_Driver::xyline(int x, int y, int x1, int y2, int x3) {
+  calls_++;
+  draw_line(x, y, x1, y);
+  draw_line(x1, y, x1, y2);
+  draw_line(x1, y2, x3, y2);
+}
+
+void Fl_Headless_Graphics_Driver::yxline(int x, int y, int y1) {
+  calls_++;
+  draw_line(x, y, x, y1);
+}
+
+void Fl_Headless_Graphics_Driver::yxline(int x, int y, int y1, int x2) {
+  calls_++;
+  draw_line(x, y, x, y1);
+  draw_line(x, y1, x2, y1);
+}
+
+void Fl_Headless_Graphics_Driver::yxline(int x, int y, int y1, int x2, int y3) {
+  calls_++;
+  draw_line(x, y, x, y1);
+  draw_line(x, y1, x2, y1);
+  draw_line(x2, y1, x2, y3);
+}
+
+void Fl_Headless_Graphics_Driver::line(int x, int y, int x1, int y1) {
+  calls_++;
+  draw_line(x, y, x1, y1);
+}
+
+void Fl_Headless_Graphics_Driver::line(int x, int y, int x1, int y1, int x2, int y2) {
+  calls_++;
+  draw_line(x, y, x1, y1);
+  draw_line(x1, y1, x2, y2);
+}
+
+void Fl_Headless_Graphics_Driver::point(int x, int y) {
+  calls_++;
+  pixel(x + ox_, y + oy_);
+}
+
+void Fl_Headless_Graphics_Driver::loop(int x0, int y0, int x1, int y1, int x2, int y2) {
+  calls_++;
+  draw_line(x0, y0, x1, y1);
+  draw_line(x1, y1, x2, y2);
+  draw_line(x2, y2, x0, y0);
+}
+
+void Fl_Headless_Graphics_Driver::loop(int x0, int y0, int x1, int y1,
+                                       int x2, int y2, int x3, int y3) {
+  calls_++;
+  draw_line(x0, y0, x1, y1);
+  draw_line(x1, y1, x2, y2);
+  draw_line(x2, y2, x3, y3);
+  draw_line(x3, y3, x0, y0);
+}
+
+void Fl_Headless_Graphics_Driver::polygon(int x0, int y0, int x1, int y1, int x2, int y2) {
+  calls_++;
+  int xy[6] = {x0, y0, x1, y1, x2, y2};
+  fill_polygon(xy, 3);
+}
+
+void Fl_Headless_Graphics_Driver::polygon(int x0, int y0, int x1, int y1,
+                                          int x2, int y2, int x3, int y3) {
+  calls_++;
+  int xy[8] = {x0, y0, x1, y1, x2, y2, x3, y3};
+  fill_polygon(xy, 4);
+}
+
+void Fl_Headless_Graphics_Driver::end_points() {
+  calls_++;
+  XPOINT *p = vertices();
+  for (int i = 0; i < vertex_no(); i++) pixel(p[i].x + ox_, p[i].y + oy_);
+}
+
+void Fl_Headless_Graphics_Driver::end_line() {
+  if (vertex_no() < 2) {end_points(); return;}
+  calls_++;
+  XPOINT *p = vertices();
+  for (int i = 1; i < vertex_no(); i++) draw_line(p[i-1].x, p[i-1].y, p[i].x, p[i].y);
+}
+
+void Fl_Headless_Graphics_Driver::end_polygon() {
+  XPOINT *p = vertices();
+  int n = vertex_no();
+  while (n > 2 && p[n-1].x == p[0].x && p[n-1].y == p[0].y) n--;
+  if (n < 3) {end_line(); return;}
+  calls_++;
+  int *xy = (int*)malloc(n * 2 * sizeof(int));
+  for (int i = 0; i < n; i++) {xy[2*i] = p[i].x; xy[2*i+1] = p[i].y;}
+  fill_polygon(xy, n);
+  free(xy);
+}
+
+void Fl_Headless_Graphics_Driver::end_complex_polygon() {
+  gap();
+  // gap() closed all sub-paths, so the even-odd rule cuts out the holes
+  end_polygon();
+}
+
+void Fl_Headless_Graphics_Driver::circle(double x, double y, double r) {
+  calls_++;
+  double xt = transform_x(x, y), yt = transform_y(x, y);
+  double rx = r * (fl_matrix->c ? sqrt(fl_matrix->a*fl_matrix->a+fl_matrix->c*fl_matrix->c) : fabs(fl_matrix->a));
+  double ry = r * (fl_matrix->b ? sqrt(fl_matrix->b*fl_matrix->b+fl_matrix->d*fl_matrix->d) : fabs(fl_matrix->d));
+  int llx = (int)rint(xt-rx);
+  int w = (int)rint(xt+rx)-llx;
+  int lly = (int)rint(yt-ry);
+  int h = (int)rint(yt+ry)-lly;
+  ellipse(llx, lly, w, h, 0, 360, vertex_kind() == POLYGON);
+}
+
+void Fl_Headless_Graphics_Driver::arc(int x, int y, int w, int h, double a1, double a2) {
+  calls_++;
+  ellipse(x, y, w, h, a1, a2, 0);
+}
+
+void Fl_Headless_Graphics_Driver::pie(int x, int y, int w, int h, double a1, double a2) {
+  calls_++;
+  ellipse(x, y, w - 1, h - 1, a1, a2, 1);
+}
+
+void Fl_Headless_Graphics_Driver::push_clip(int x, int y, int w, int h) {
+  if (clip_n_ + 1 >= clip_size_) {
+    clip_size_ *= 2;
+    clip_ = (Clip*)realloc(clip_, clip_size_ * sizeof(Clip));
+  }
+  const Clip &c = clip_[clip_n_];
+  Clip &n = clip_[++clip_n_];
+  n.x = x + ox_; n.y = y + oy_; n.r = n.x + w; n.b = n.y + h;
+  if (n.x < c.x) n.x = c.x;
+  if (n.y < c.y) n.y = c.y;
+  if (n.r > c.r) n.r = c.r;
+  if (n.b > c.b) n.b = c.b;
+  if (n.r < n.x) n.r = n.x;
+  if (n.b < n.y) n.b = n.y;
+}
+
+int Fl_Headless_Graphics_Driver::clip_box(int x, int y, int w, int h,
+                                          int &X, int &Y, int &W, int &H) {
+  X = x; Y = y; W = w; H = h;
+  if (w <= 0 || h <= 0) return 0;
+  const Clip &c = clip_[clip_n_];
+  int cx = c.x - ox_, cy = c.y - oy_, cr = c.r - ox_, cb = c.b - oy_;
+  if (X < cx) X = cx;
+  if (Y < cy) Y = cy;
+  int r = x + w, b = y + h;
+  if (r > cr) r = cr;
+  if (b > cb) b = cb;
+  W = r > X ? r - X : 0;
+  H = b > Y ? b - Y : 0;
+  return X != x || Y != y || W != w || H != h;
+}
+
+int Fl_Headless_Graphics_Driver::not_clipped(int x, int y, int w, int h) {
+  const Clip &c = clip_[clip_n_];
+  x += ox_; y += oy_;
+  if (x + w <= c.x || y + h <= c.y || x >= c.r || y >= c.b) return 0;
+  if (x >= c.x && y >= c.y && x + w <= c.r && y + h <= c.b) return 1;
+  return 2;
+}
+
+void Fl_Headless_Graphics_Driver::push_no_clip() {
+  if (clip_n_ + 1 >= clip_size_) {
+    clip_size_ *= 2;
+    clip_ = (Clip*)realloc(clip_, clip_size_ * sizeof(Clip));
+  }
+  clip_[++clip_n_] = clip_[0];
+}
+
+void Fl_Headless_Graphics_Driver::pop_clip() {
+  if (clip_n_ > 0) clip_n_--;
+}
+
+void Fl_Headless_Graphics_Driver::draw(const char *str, int n, int x, int y) {
+  calls_++;
+}
+
+void Fl_Headless_Graphics_Driver::draw(int angle, const char *str, int n, int x, int y) {
+  calls_++;
+}
+
+void Fl_Headless_Graphics_Driver::rtl_draw(const char *str, int n, int x, int y) {
+  calls_++;
+}
+
+// Text is measured as if all characters were half as wide as the font
+// size, counting UTF-8 characters rather than bytes.
+double Fl_Headless_Graphics_Driver::width(const char *str, int n) {
+  int chars = 0;
+  for (int i = 0; i < n; i++) if ((str[i] & 0xc0) != 0x80) chars++;
+  return chars * size() * 0.5;
+}
+
+double Fl_Headless_Graphics_Driver::width(unsigned int c) {
+  return size() * 0.5;
+}
+
+int Fl_Headless_Graphics_Driver::height() {
+  return size() + descent();
+}
+
+int Fl_Headless_Graphics_Driver::descent() {
+  return size() / 4;
+}
+
+// Copies W*H pixels of depth D to X,Y. Depths 2 and 4 are blended
+// with the surface if FL_IMAGE_WITH_ALPHA is set, like on the display.
+static void copy_pixels(uchar *dst, const uchar *src, int W, int D) {
+  int alpha = (D & FL_IMAGE_WITH_ALPHA) != 0;
+  D &= ~FL_IMAGE_WITH_ALPHA;
+  for (int i = 0; i < W; i++, dst += 3, src += D) {
+    uchar r, g, b;
+    if (D < 3) r = g = b = src[0];
+    else {r = src[0]; g = src[1]; b = src[2];}
+    if (alpha && (D == 2 || D == 4)) {
+      unsigned a = src[D-1];
+      dst[0] = (uchar)((r * a + dst[0] * (255 - a)) / 255);
+      dst[1] = (uchar)((g * a + dst[1] * (255 - a)) / 255);
+      dst[2] = (uchar)((b * a + dst[2] * (255 - a)) / 255);
+    } else {
+      dst[0] = r; dst[1] = g; dst[2] = b;
+    }
+  }
+}
+
+void Fl_Headless_Graphics_Driver::draw_image(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  calls_++;
+  int depth = D & ~FL_IMAGE_WITH_ALPHA;
+  if (!L) L = W * depth;
+  int x, y, w, h;
+  clip_box(X, Y, W, H, x, y, w, h);
+  if (w <= 0 || h <= 0) return;
+  for (int j = 0; j < h; j++) {
+    const uchar *src = buf + (y - Y + j) * L + (x - X) * depth;
+    copy_pixels(buf_ + ((y + oy_ + j) * w_ + x + ox_) * 3, src, w, D);
+  }
+}
+
+void Fl_Headless_Graphics_Driver::draw_image_mono(const uchar* buf, int X, int Y, int W, int H, int D, int L) {
+  calls_++;
+  if (!L) L = W * D;
+  int x, y, w, h;
+  clip_box(X, Y, W, H, x, y, w, h);
+  if (w <= 0 || h <= 0) return;
+  for (int j = 0; j < h; j++) {
+    const uchar *src = buf + (y - Y + j) * L + (x - X) * D;
+    uchar *dst = buf_ + ((y + oy_ + j) * w_ + x + ox_) * 3;
+    for (int i = 0; i < w; i++, dst += 3, src += D) dst[0] = dst[1] = dst[2] = *src;
+  }
+}
+
+void Fl_Headless_Graphics_Driver::draw_image(Fl_Draw_Image_Cb cb, void* data, int X, int Y, int W, int H, int D) {
+  calls_++;
+  int x, y, w, h;
+  clip_box(X, Y, W, H, x, y, w, h);
+  if (w <= 0 || h <= 0) return;
+  uchar *line = new uchar[w * (D & ~FL_IMAGE_WITH_ALPHA)];
+  for (int j = 0; j < h; j++) {
+    cb(data, x - X, y - Y + j, w, line);
+    copy_pixels(buf_ + ((y + oy_ + j) * w_ + x + ox_) * 3, line, w, D);
+  }
+  delete[] line;
+}
+
+void Fl_Headless_Graphics_Driver::draw_image_mono(Fl_Draw_Image_Cb cb, void* data, int X, int Y, int W, int H, int D) {
+  calls_++;
+  int x, y, w, h;
+  clip_box(X, Y, W, H, x, y, w, h);
+  if (w <= 0 || h <= 0) return;
+  uchar *line = new uchar[w * D];
+  for (int j = 0; j < h; j++) {
+    cb(data, x - X, y - Y + j, w, line);
+    uchar *dst = buf_ + ((y + oy_ + j) * w_ + x + ox_) * 3;
+    for (int i = 0; i < w; i++, dst += 3) dst[0] = dst[1] = dst[2] = line[i * D];
+  }
+  delete[] line;
+}
+
+void Fl_Headless_Graphics_Driver::draw(Fl_RGB_Image *img, int XP, int YP, int WP, int HP, int cx, int cy) {
+  if (!img->d() || !img->array) return;
+  // clip the box down to the size of image, like the display drivers do:
+  if (cx < 0) {WP += cx; XP -= cx; cx = 0;}
+  if (cx + WP > img->w()) WP = img->w() - cx;
+  if (cy < 0) {HP += cy; YP -= cy; cy = 0;}
+  if (cy + HP > img->h()) HP = img->h() - cy;
+  if (WP <= 0 || HP <= 0) return;
+  int ld = img->ld() ? img->ld() : img->w() * img->d();
+  int D = img->d();
+  if (D == 2 || D == 4) D |= FL_IMAGE_WITH_ALPHA;
+  draw_image(img->array + cy * ld + cx * img->d(), XP, YP, WP, HP, D, ld);
+}
+
+////////////////////////////////////////////////////////////////
+// Fl_Headless_Surface
+
+/**
+  Creates a surface of \p w by \p h pixels, filled with FL_BACKGROUND_COLOR.
+*/
+Fl_Headless_Surface::Fl_Headless_Surface(int w, int h) : Fl_Surface_Device(NULL) {
+  driver_ = new Fl_Headless_Graphics_Driver();
+  driver_->w_ = w > 0 ? w : 1;
+  driver_->h_ = h > 0 ? h : 1;
+  driver_->buf_ = new uchar[driver_->w_ * driver_->h_ * 3];
+  driver_->clip_[0].r = driver_->w_;
+  driver_->clip_[0].b = driver_->h_;
+  driver(driver_);
+  clear();
+}
+
+/**
+  Deletes the surface. The display becomes the current drawing surface
+  if this surface was current.
+*/
+Fl_Headless_Surface::~Fl_Headless_Surface() {
+  if (Fl_Surface_Device::surface() == this)
+    Fl_Display_Device::display_device()->set_current();
+  delete driver_;
+}
+
+/**
+  Fills the whole surface with color \p c.
+*/
+void Fl_Headless_Surface::clear(Fl_Color c) {
+  uchar r, g, b;
+  Fl::get_color(c, r, g, b);
+  uchar *p = driver_->buf_;
+  for (int i = driver_->w_ * driver_->h_; i > 0; i--, p += 3) {
+    p[0] = r; p[1] = g; p[2] = b;
+  }
+}
+
+/**
+  Draws a widget and all its children, including subwindows.
+
+  The whole widget is redrawn, whatever its damage() is, and its damage
+  is cleared afterwards. Groups whose layout was deferred are laid out
+  first, see Fl::layout(). The surface must be current, see set_current().
+
+  \param[in] widget any FLTK widget (e.g., standard, custom, window)
+  \param[in] delta_x,delta_y offsets of the widget's top left corner from
+  the current origin of the surface, which is 0,0 outside of draw()
+*/
+void Fl_Headless_Surface::draw(Fl_Widget *widget, int delta_x, int delta_y) {
+  if (!widget->visible()) return;
+  Fl::layout();	// place the children of groups resized with deferred layout
+  int old_x = driver_->ox_, old_y = driver_->oy_;
+  int is_window = widget->as_window() != NULL;
+  driver_->ox_ += delta_x;
+  driver_->oy_ += delta_y;
+  if (!is_window) {
+    driver_->ox_ -= widget->x();
+    driver_->oy_ -= widget->y();
+  } else {
+    fl_push_clip(0, 0, widget->w(), widget->h());
+  }
+  widget->clear_damage(FL_DAMAGE_ALL);
+  widget->draw();
+  widget->clear_damage();
+  draw_subwindows(widget);
+  if (is_window) fl_pop_clip();
+  driver_->ox_ = old_x;
+  driver_->oy_ = old_y;
+}
+
+// Subwindows are not drawn by Fl_Group::draw_children(), find them here.
+void Fl_Headless_Surface::draw_subwindows(Fl_Widget *widget) {
+  Fl_Group *g = widget->as_group();
+  if (!g) return;
+  int n = g->children();
+  for (int i = 0; i < n; i++) {
+    Fl_Widget *c = g->child(i);
+    if (!c->visible()) continue;
+    if (c->as_window()) draw(c, c->x(), c->y());
+    else draw_subwindows(c);
+  }
+}
+
+/**
+  Returns a copy of the surface as a new image. The caller must delete it.
+*/
+Fl_RGB_Image *Fl_Headless_Surface::image() {
+  int n = driver_->w_ * driver_->h_ * 3;
+  uchar *data = new uchar[n];
+  memcpy(data, driver_->buf_, n);
+  Fl_RGB_Image *img = new Fl_RGB_Image(data, driver_->w_, driver_->h_);
+  img->alloc_array = 1;
+  return img;
+}
+
+////////////////////////////////////////////////////////////////
+// Fl_Headless
+
+static int click_x, click_y;	// where the last button was pushed
+static char key_text[32];	// FL_KEYBOARD may change the event text
+
+// Sets the mouse position like a pointer event from the system would.
+static void set_event_xy(Fl_Window *win, int x, int y) {
+  Fl::e_x = x;
+  Fl::e_y = y;
+  Fl::e_x_root = x + win->x_root();
+  Fl::e_y_root = y + win->y_root();
+}
+
+// The system sends these before any mouse or keyboard event arrives:
+static void enter(Fl_Window *win) {
+  if (fl_xmousewin != win) Fl::handle(FL_ENTER, win);
+}
+
+static void focus(Fl_Window *win) {
+  Fl_Window *top = win;
+  while (top->window()) top = top->window();
+  if (fl_xfocus != top) Fl::handle(FL_FOCUS, top);
+}
+
+static Fl_Graphics_Driver *display_driver;	// the display's own driver
+static Fl_Headless_Surface *display_surface;	// replaces it while headless
+
+/**
+  Switches headless operation on or off.
+
+  Call this before any widget is created or shown. The graphics driver
+  of the display is replaced by an Fl_Headless_Graphics_Driver, so that
+  text can be measured without a display and drawing outside of an
+  Fl_Headless_Surface is discarded. Tooltips are disabled because they
+  would need their own window.
+*/
+void Fl_Headless::enable(int on) {
+  Fl_Display_Device *display = Fl_Display_Device::display_device();
+  on = on ? 1 : 0;
+  if (on == enabled_) return;
+  enabled_ = on;
+  if (on) {
+    if (!display_surface) display_surface = new Fl_Headless_Surface(1, 1);
+    display_driver = display->driver();
+    display->driver(display_surface->driver());
+    Fl_Tooltip::disable();
+  } else {
+    display->driver(display_driver);
+  }
+  if (Fl_Surface_Device::surface() == display) display->set_current();
+}
+
+/**
+  Sends a mouse button push to a window.
+
+  \param[in] win the window, usually a top-level window
+  \param[in] x,y position relative to the window
+  \param[in] button the button number, 1 is the left button
+  \param[in] clicks value for Fl::event_clicks(), 1 for a double click
+  \returns the result of Fl::handle()
+*/
+int Fl_Headless::push(Fl_Window *win, int x, int y, int button, int clicks) {
+  enter(win);
+  focus(win);
+  set_event_xy(win, x, y);
+  click_x = x; click_y = y;
+  Fl::e_state |= FL_BUTTON(button);
+  Fl::e_keysym = FL_Button + button;
+  Fl::e_clicks = clicks;
+  Fl::e_is_click = 1;
+  return Fl::handle(FL_PUSH, win);
+}
+
+/**
+  Moves the mouse with a button pushed.
+  \returns the result of Fl::handle()
+*/
+int Fl_Headless::drag(Fl_Window *win, int x, int y) {
+  set_event_xy(win, x, y);
+  if (abs(x - click_x) > 5 || abs(y - click_y) > 5) Fl::e_is_click = 0;
+  return Fl::handle(FL_DRAG, win);
+}
+
+/**
+  Releases a mouse button.
+  \returns the result of Fl::handle()
+*/
+int Fl_Headless::release(Fl_Window *win, int x, int y, int button) {
+  set_event_xy(win, x, y);
+  if (abs(x - click_x) > 5 || abs(y - click_y) > 5) Fl::e_is_click = 0;
+  Fl::e_state &= ~FL_BUTTON(button);
+  Fl::e_keysym = FL_Button + button;
+  return Fl::handle(FL_RELEASE, win);
+}
+
+/**
+  Moves the mouse with no button pushed.
+  \returns the result of Fl::handle()
+*/
+int Fl_Headless::move(Fl_Window *win, int x, int y) {
+  enter(win);
+  set_event_xy(win, x, y);
+  return Fl::handle(FL_MOVE, win);
+}
+
+/**
+  Turns the mouse wheel by \p dx and \p dy steps at position \p x, \p y.
+  \returns the result of Fl::handle()
+*/
+int Fl_Headless::wheel(Fl_Window *win, int x, int y, int dx, int dy) {
+  enter(win);
+  set_event_xy(win, x, y);
+  Fl::e_dx = dx;
+  Fl::e_dy = dy;
+  return Fl::handle(FL_MOUSEWHEEL, win);
+}
+
+/**
+  Sends a key press and release to the window.
+
+  \param[in] win the window, it gets the keyboard focus
+  \param[in] key the key code, see Fl::event_key()
+  \param[in] text the text the key produces, e.g. "a", or NULL
+  \param[in] state shift state, e.g. FL_SHIFT|FL_CTRL
+  \returns the result of Fl::handle() for the key press
+*/
+int Fl_Headless::key(Fl_Window *win, int key, const char *text, int state) {
+  focus(win);
+  Fl::e_keysym = Fl::e_original_keysym = key;
+  Fl::e_state = (Fl::e_state & FL_BUTTONS) | state;
+  Fl::e_is_click = 0;
+  strlcpy(key_text, text ? text : "", sizeof(key_text));
+  Fl::e_text = key_text;
+  Fl::e_length = (int) strlen(key_text);
+  int ret = Fl::handle(FL_KEYDOWN, win);
+  strlcpy(key_text, text ? text : "", sizeof(key_text));
+  Fl::e_length = (int) strlen(key_text);
+  Fl::handle(FL_KEYUP, win);
+  return ret;
+}
+
+/**
+  Resizes a window like the window manager would.
+*/
+void Fl_Headless::resize(Fl_Window *win, int w, int h) {
+  win->resize(win->x(), win->y(), w, h);
+}
+
+/**
+  Runs the event loop for \p seconds, calling timeouts and idle, check
+  and Fl::add_fd() callbacks. If \p seconds is zero, this works like
+  Fl::check().
+*/
+void Fl_Headless::run(double seconds) {
+  double end = fl_loop_stat_time() + seconds;
+  do {
+    double left = end - fl_loop_stat_time();
+    Fl::wait(left > 0.0 ? left : 0.0);
+  } while (fl_loop_stat_time() < end);
+}
+
+//
+// End of "$Id$".
+//
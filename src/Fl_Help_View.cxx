@@ -3257,6 +3257,8 @@ Fl_Help_View::Fl_Help_View(int        xx,	// I - Left position
   hsize_        = 0;
   scrollbar_size_ = 0;
 
+  set_flag(SHORTCUT_HANDLER);	// uses Ctrl-A and Ctrl-C
+
   scrollbar_.value(0, hh, 0, 1);
   scrollbar_.step(8.0);
   scrollbar_.show();
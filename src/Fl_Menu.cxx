@@ -28,6 +28,7 @@
 #include <FL/fl_draw.H>
 #include <stdio.h>
 #include "flstring.h"
+#include "Fl_Shortcut_Index.H"
 
 /** Size of the menu starting from this menu item.
 
@@ -1036,7 +1037,8 @@ const Fl_Menu_Item* Fl_Menu_Item::popup(
 const Fl_Menu_Item* Fl_Menu_Item::find_shortcut(int* ip, const bool require_alt) const {
   const Fl_Menu_Item* m = this;
   if (m) for (int ii = 0; m->text; m = next_visible_or_not(m), ii++) {
-    if (m->active()) {
+    // the shortcut index wants the shortcuts of inactive items, too:
+    if (m->active() || Fl_Shortcut_Index::collecting) {
       if (Fl::test_shortcut(m->shortcut_)
 	 || Fl_Widget::test_shortcut(m->text, require_alt)) {
 	if (ip) *ip=ii;
@@ -1061,7 +1063,7 @@ const Fl_Menu_Item* Fl_Menu_Item::test_shortcut() const {
   const Fl_Menu_Item* m = this;
   const Fl_Menu_Item* ret = 0;
   if (m) for (; m->text; m = next_visible_or_not(m)) {
-    if (m->active()) {
+    if (m->active() || Fl_Shortcut_Index::collecting) {
       // return immediately any match of an item in top level menu:
       if (Fl::test_shortcut(m->shortcut_)) return m;
       // if (Fl_Widget::test_shortcut(m->text)) return m;
@@ -418,6 +418,7 @@ int Fl_Menu_::size() const {
 void Fl_Menu_::menu(const Fl_Menu_Item* m) {
   clear();
   value_ = menu_ = (Fl_Menu_Item*)m;
+  shortcuts_changed();
 }
 
 // this version is ok with new Fl_Menu_add code with fl_menu_array_owner:
@@ -19,6 +19,7 @@
 #include <FL/Fl.H>
 #include <FL/Fl_Menu_Bar.H>
 #include <FL/fl_draw.H>
+#include "Fl_Shortcut_Index.H"
 
 void Fl_Menu_Bar::draw() {
   draw_box();
@@ -55,7 +56,7 @@ int Fl_Menu_Bar::handle(int event) {
     picked(v);
     return 1;
   case FL_SHORTCUT:
-    if (visible_r()) {
+    if (visible_r() || Fl_Shortcut_Index::collecting) {
       v = menu()->find_shortcut(0, true);
       if (v && v->submenu()) goto J1;
     }
@@ -411,6 +411,7 @@ int Fl_Menu_::insert(
   int value_offset = (int) (value_-menu_);
   menu_ = local_array; // in case it reallocated it
   if (value_) value_ = menu_+value_offset;
+  shortcuts_changed();
   return r;
 }
 
@@ -467,6 +468,7 @@ void Fl_Menu_::replace(int i, const char *str) {
     str = strdup(str);
   }
   menu_[i].text = str;
+  shortcuts_changed();
 }
 
 
@@ -493,6 +495,7 @@ void Fl_Menu_::remove(int i) {
   }
   // MRS: "n" is the menu size(), which includes the trailing NULL entry...
   memmove(item, next_item, (menu_+n-next_item)*sizeof(Fl_Menu_Item));
+  shortcuts_changed();
 }
 
 //
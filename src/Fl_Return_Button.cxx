@@ -64,6 +64,7 @@ int Fl_Return_Button::handle(int event) {
 Fl_Return_Button::Fl_Return_Button(int X, int Y, int W, int H,const char *l)
 : Fl_Button(X,Y,W,H,l) 
 {
+  set_flag(SHORTCUT_HANDLER); // it uses the Enter key
 }
 
 
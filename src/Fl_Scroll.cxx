@@ -20,6 +20,272 @@
 #include <FL/Fl_Tiled_Image.H>
 #include <FL/Fl_Scroll.H>
 #include <FL/fl_draw.H>
+#include <stdlib.h>
+
+#if FLTK_ABI_VERSION >= 10304
+
+// Lazy scrolling
+//
+// Every child has a logical box, the place it would have if the
+// contents were not scrolled. Instead of moving all children by the
+// same amount in scroll_to(), only the children that can be seen are
+// moved. The children in 'placed' are displaced by (cx,cy) from their
+// logical box, which follows the scroll position. All other children
+// are displaced by (bx,by), which only changes when the Fl_Scroll is
+// moved, and they are always outside of the scroll area, because
+// 'placed' contains all children that would be visible with either
+// displacement. The logical boxes are sorted along the direction in
+// which the contents extend most, so the visible children are found
+// with a binary search.
+//
+// A true translation, where the children keep their logical position
+// and the offset is applied when drawing and handling events, does not
+// work in FLTK 1.3, because the graphics drivers have no drawing origin
+// and widgets draw themselves at x(), y().
+
+// A set of widgets.
+struct Fl_Scroll_List {
+  Fl_Widget **p;
+  int n, size;
+  int sorted;		// sorted by address, without duplicates
+  Fl_Scroll_List() : p(0), n(0), size(0), sorted(1) {}
+  ~Fl_Scroll_List() {free(p);}
+  void add(Fl_Widget *w) {
+    if (n >= size) {
+      size = size ? 2 * size : 32;
+      p = (Fl_Widget**)realloc((void*)p, size * sizeof(Fl_Widget*));
+    }
+    p[n++] = w;
+    sorted = 0;
+  }
+  void sort();
+  int contains(Fl_Widget *w) const;
+  void swap(Fl_Scroll_List &l) {
+    Fl_Scroll_List t = *this; *this = l; l = t;
+    t.p = 0;	// don't free it
+  }
+};
+
+struct Fl_Scroll_Box {
+  Fl_Widget *w;
+  int x, y, r, b;	// logical box
+};
+
+struct Fl_Scroll_Lazy {
+  int dirty;			// boxes must be rebuilt
+  int resized;			// the scroll area changed, find visible again
+  int moving;			// Fl_Scroll is moving children itself
+  int cx, cy;			// displacement of the placed children
+  int bx, by;			// displacement of all other children
+  Fl_Scroll_List placed;	// children displaced by cx, cy
+  Fl_Scroll_List visible;	// children that are visible when displaced by bx, by
+  Fl_Scroll_List always;	// outside labels or bigger than the scroll area
+  Fl_Scroll_Box *boxes;		// logical boxes sorted along the axis
+  int nboxes;
+  Fl_Scroll_Box *added;		// boxes of children added since the last rebuild
+  int nadded, aadded;
+  int vertical;			// boxes are sorted by y instead of x
+  int maxsize;			// biggest box size along the axis
+  int empty, l, t, r, b;	// logical bounding box of all children
+  int *order, norder;		// indices of the placed children, in drawing order
+  Fl_Scroll_Lazy() {
+    dirty = 1;
+    resized = moving = cx = cy = bx = by = 0;
+    boxes = added = 0;
+    nboxes = nadded = aadded = vertical = maxsize = 0;
+    empty = 1; l = t = r = b = 0;
+    order = 0; norder = -1;
+  }
+  ~Fl_Scroll_Lazy() {free(boxes); free(added); free(order);}
+  void add_box(Fl_Widget *o);
+  void rebuild(Fl_Scroll *s, int X, int Y, int W, int H);
+  void find(int X, int Y, int W, int H, Fl_Scroll_List &list) const;
+  void move(int ncx, int ncy, int X, int Y, int W, int H);
+  int *drawing_order(Fl_Scroll *s);
+};
+
+static int compare_pointers(const void *a, const void *b) {
+  const Fl_Widget *p = *(Fl_Widget*const*)a, *q = *(Fl_Widget*const*)b;
+  return p < q ? -1 : p > q;
+}
+
+void Fl_Scroll_List::sort() {
+  if (sorted) return;
+  qsort(p, n, sizeof(Fl_Widget*), compare_pointers);
+  int i, j;
+  for (i = j = 0; i < n; i++) if (!j || p[i] != p[j-1]) p[j++] = p[i];
+  n = j;
+  sorted = 1;
+}
+
+int Fl_Scroll_List::contains(Fl_Widget *w) const {
+  int a = 0, b = n;
+  while (a < b) {
+    int c = (a + b) / 2;
+    if (p[c] == w) return 1;
+    if (p[c] < w) a = c + 1; else b = c;
+  }
+  return 0;
+}
+
+static int compare_x(const void *a, const void *b) {
+  return ((const Fl_Scroll_Box*)a)->x - ((const Fl_Scroll_Box*)b)->x;
+}
+
+static int compare_y(const void *a, const void *b) {
+  return ((const Fl_Scroll_Box*)a)->y - ((const Fl_Scroll_Box*)b)->y;
+}
+
+static int outside_label(Fl_Widget *o) {
+  return (o->align() & 15) && !(o->align() & FL_ALIGN_INSIDE) &&
+         (o->label() || o->image());
+}
+
+// Remembers the box of a child that was added at the current scroll position.
+void Fl_Scroll_Lazy::add_box(Fl_Widget *o) {
+  if (dirty) return;
+  if (outside_label(o) || nadded > 32 + nboxes / 4) {dirty = 1; return;}
+  if (nadded >= aadded) {
+    aadded = aadded ? 2 * aadded : 32;
+    added = (Fl_Scroll_Box*)realloc((void*)added, aadded * sizeof(Fl_Scroll_Box));
+  }
+  Fl_Scroll_Box &box = added[nadded++];
+  box.w = o;
+  box.x = o->x() - cx; box.y = o->y() - cy;
+  box.r = box.x + o->w(); box.b = box.y + o->h();
+  if (empty) {l = box.x; t = box.y; r = box.r; b = box.b; empty = 0; return;}
+  if (box.x < l) l = box.x;
+  if (box.y < t) t = box.y;
+  if (box.r > r) r = box.r;
+  if (box.b > b) b = box.b;
+}
+
+// Finds the logical boxes of all children, X,Y,W,H is the scroll area.
+void Fl_Scroll_Lazy::rebuild(Fl_Scroll *s, int X, int Y, int W, int H) {
+  placed.sort();
+  Fl_Scroll_List still_placed;
+  always.n = 0;
+  nadded = 0;
+  norder = -1;
+  int n = s->children(), i;
+  free(boxes);
+  boxes = (Fl_Scroll_Box*)malloc((n + 1) * sizeof(Fl_Scroll_Box));
+  nboxes = 0;
+  empty = 1;
+  for (i = 0; i < n; i++) {
+    Fl_Widget *o = s->child(i);
+    if (o == &s->scrollbar || o == &s->hscrollbar) continue;
+    Fl_Scroll_Box &box = boxes[nboxes++];
+    box.w = o;
+    if (placed.contains(o)) {
+      still_placed.add(o);
+      box.x = o->x() - cx; box.y = o->y() - cy;
+    } else {
+      box.x = o->x() - bx; box.y = o->y() - by;
+    }
+    box.r = box.x + o->w(); box.b = box.y + o->h();
+    if (empty) {l = box.x; t = box.y; r = box.r; b = box.b; empty = 0;}
+    else {
+      if (box.x < l) l = box.x;
+      if (box.y < t) t = box.y;
+      if (box.r > r) r = box.r;
+      if (box.b > b) b = box.b;
+    }
+  }
+  vertical = b - t >= r - l;
+  // move children that are always placed out of the sorted boxes:
+  int j;
+  maxsize = 0;
+  for (i = j = 0; i < nboxes; i++) {
+    Fl_Scroll_Box &box = boxes[i];
+    int size = vertical ? box.b - box.y : box.r - box.x;
+    if (size > (vertical ? H : W) || outside_label(box.w)) {always.add(box.w); continue;}
+    if (size > maxsize) maxsize = size;
+    boxes[j++] = box;
+  }
+  nboxes = j;
+  qsort(boxes, nboxes, sizeof(Fl_Scroll_Box), vertical ? compare_y : compare_x);
+  placed.swap(still_placed);
+  placed.sort();
+  visible.n = 0;
+  find(X - bx, Y - by, W, H, visible);
+  dirty = resized = 0;
+}
+
+// Adds the children whose logical box overlaps X,Y,W,H to the list.
+void Fl_Scroll_Lazy::find(int X, int Y, int W, int H, Fl_Scroll_List &list) const {
+  int lo = vertical ? Y : X, hi = vertical ? Y + H : X + W;
+  // first box that may reach lo:
+  int a = 0, c = nboxes;
+  while (a < c) {
+    int m = (a + c) / 2;
+    if ((vertical ? boxes[m].y : boxes[m].x) + maxsize <= lo) a = m + 1;
+    else c = m;
+  }
+  for (; a < nboxes; a++) {
+    const Fl_Scroll_Box &box = boxes[a];
+    if ((vertical ? box.y : box.x) >= hi) break;
+    if (box.x < X + W && box.r > X && box.y < Y + H && box.b > Y) list.add(box.w);
+  }
+  for (a = 0; a < nadded; a++) {
+    const Fl_Scroll_Box &box = added[a];
+    if (box.x < X + W && box.r > X && box.y < Y + H && box.b > Y) list.add(box.w);
+  }
+}
+
+// Displaces the placed children by ncx, ncy and places the children
+// that become visible, X,Y,W,H is the scroll area.
+void Fl_Scroll_Lazy::move(int ncx, int ncy, int X, int Y, int W, int H) {
+  if (resized) { // the other children may be visible now
+    visible.n = 0;
+    find(X - bx, Y - by, W, H, visible);
+    resized = 0;
+  }
+  Fl_Scroll_List next;
+  find(X - ncx, Y - ncy, W, H, next);
+  int i;
+  for (i = 0; i < visible.n; i++) next.add(visible.p[i]);
+  for (i = 0; i < always.n; i++) next.add(always.p[i]);
+  next.sort();
+  placed.sort();
+  moving = 1;
+  for (i = 0; i < placed.n; i++) {
+    Fl_Widget *o = placed.p[i];
+    if (!next.contains(o)) o->position(o->x() + bx - cx, o->y() + by - cy);
+  }
+  for (i = 0; i < next.n; i++) {
+    Fl_Widget *o = next.p[i];
+    int dx, dy;
+    if (placed.contains(o)) {dx = ncx - cx; dy = ncy - cy;}
+    else {dx = ncx - bx; dy = ncy - by;}
+    if (dx || dy) o->position(o->x() + dx, o->y() + dy);
+  }
+  moving = 0;
+  placed.swap(next);
+  cx = ncx; cy = ncy;
+  norder = -1;
+}
+
+static int compare_ints(const void *a, const void *b) {
+  return *(const int*)a - *(const int*)b;
+}
+
+// Returns the indices of the placed children in drawing order, the
+// number of children is in norder.
+int *Fl_Scroll_Lazy::drawing_order(Fl_Scroll *s) {
+  if (norder >= 0) return order;
+  free(order);
+  order = (int*)malloc((placed.n + 1) * sizeof(int));
+  norder = 0;
+  for (int i = 0; i < placed.n; i++) {
+    int k = s->find(placed.p[i]);
+    if (k < s->children()) order[norder++] = k;
+  }
+  qsort(order, norder, sizeof(int), compare_ints);
+  return order;
+}
+
+#endif // FLTK_ABI_VERSION >= 10304
 
 /** Clear all but the scrollbars... */
 void Fl_Scroll::clear() {
@@ -81,6 +347,18 @@ void Fl_Scroll::draw_clip(void* v,int X, int Y, int W, int H) {
 	break;
   }
   Fl_Widget*const* a = s->array();
+#if FLTK_ABI_VERSION >= 10304
+  if (s->lazy_) { // only the placed children can be visible
+    int *order = s->lazy_->drawing_order(s);
+    for (int i = 0; i < s->lazy_->norder; i++) {
+      Fl_Widget& o = *a[order[i]];
+      s->draw_child(o);
+      s->draw_outside_label(o);
+    }
+    fl_pop_clip();
+    return;
+  }
+#endif
   for (int i=s->children()-2; i--;) {
     Fl_Widget& o = **a++;
     s->draw_child(o);
@@ -114,6 +392,19 @@ void Fl_Scroll::recalc_scrollbars(ScrollInfo &si) {
   si.child.t = si.innerbox.y;
   int first = 1;
   Fl_Widget*const* a = array();
+#if FLTK_ABI_VERSION >= 10304
+  if (lazy_) { // use the cached bounding box
+    lazy_update();
+    if (!lazy_->empty) {
+      si.child.l = lazy_->l + lazy_->cx;
+      si.child.r = lazy_->r + lazy_->cx;
+      si.child.t = lazy_->t + lazy_->cy;
+      si.child.b = lazy_->b + lazy_->cy;
+    }
+    first = 0;
+  }
+  if (first)
+#endif
   for (int i=children(); i--;) {
     Fl_Widget* o = *a++;
     if ( o==&scrollbar || o==&hscrollbar ) continue;
@@ -239,6 +530,9 @@ void Fl_Scroll::bbox(int& X, int& Y, int& W, int& H) {
 
 void Fl_Scroll::draw() {
   fix_scrollbar_order();
+#if FLTK_ABI_VERSION >= 10304
+  if (lazy_) lazy_update();
+#endif
   int X,Y,W,H; bbox(X,Y,W,H);
 
   uchar d = damage();
@@ -258,6 +552,14 @@ void Fl_Scroll::draw() {
       R = 0;
       T = 999999;
       B = 0;
+#if FLTK_ABI_VERSION >= 10304
+      if (lazy_) {
+        if (!lazy_->empty) {
+          L = lazy_->l + lazy_->cx; R = lazy_->r + lazy_->cx;
+          T = lazy_->t + lazy_->cy; B = lazy_->b + lazy_->cy;
+        }
+      } else
+#endif
       for (int i=children()-2; i--; a++) {
         if ((*a)->x() < L) L = (*a)->x();
 	if (((*a)->x() + (*a)->w()) > R) R = (*a)->x() + (*a)->w();
@@ -272,6 +574,12 @@ void Fl_Scroll::draw() {
     if (d & FL_DAMAGE_CHILD) { // draw damaged children
       fl_push_clip(X, Y, W, H);
       Fl_Widget*const* a = array();
+#if FLTK_ABI_VERSION >= 10304
+      if (lazy_) {
+        int *order = lazy_->drawing_order(this);
+        for (int i = 0; i < lazy_->norder; i++) update_child(*a[order[i]]);
+      } else
+#endif
       for (int i=children()-2; i--;) update_child(**a++);
       fl_pop_clip();
     }
@@ -341,6 +649,9 @@ void Fl_Scroll::draw() {
   \note Fl_Scroll::resize() does \b not call Fl_Group::resize(), and
   child widgets are \b not resized.
 
+  With lazy_scroll() on, only the children that are visible before or
+  after the change are moved, like when scrolling.
+
   Since children of an Fl_Scroll are not resized, the resizable() widget
   is ignored (if it is set).
 
@@ -359,11 +670,18 @@ void Fl_Scroll::resize(int X, int Y, int W, int H) {
   int dw = W-w(), dh = H-h();
   Fl_Widget::resize(X,Y,W,H); // resize _before_ moving children around
   fix_scrollbar_order();
-  // move all the children:
-  Fl_Widget*const* a = array();
-  for (int i=children()-2; i--;) {
-    Fl_Widget* o = *a++;
-    o->position(o->x()+dx, o->y()+dy);
+#if FLTK_ABI_VERSION >= 10304
+  if (lazy_) { // move the visible children only
+    lazy_->resized = 1;
+    lazy_move(dx, dy);
+  } else
+#endif
+  { // move all the children:
+    Fl_Widget*const* a = array();
+    for (int i=children()-2; i--;) {
+      Fl_Widget* o = *a++;
+      o->position(o->x()+dx, o->y()+dy);
+    }
   }
   if (dw==0 && dh==0) {
     char pad = ( scrollbar.visible() && hscrollbar.visible() );
@@ -399,11 +717,18 @@ void Fl_Scroll::scroll_to(int X, int Y) {
   if (!dx && !dy) return;
   xposition_ = X;
   yposition_ = Y;
-  Fl_Widget*const* a = array();
-  for (int i=children(); i--;) {
-    Fl_Widget* o = *a++;
-    if (o == &hscrollbar || o == &scrollbar) continue;
-    o->position(o->x()+dx, o->y()+dy);
+#if FLTK_ABI_VERSION >= 10304
+  if (lazy_) {
+    lazy_move(dx, dy);
+  } else
+#endif
+  {
+    Fl_Widget*const* a = array();
+    for (int i=children(); i--;) {
+      Fl_Widget* o = *a++;
+      if (o == &hscrollbar || o == &scrollbar) continue;
+      o->position(o->x()+dx, o->y()+dy);
+    }
   }
   if (parent() == (Fl_Group *)window() && Fl::scheme_bg_) damage(FL_DAMAGE_ALL);
   else damage(FL_DAMAGE_SCROLL);
@@ -439,16 +764,132 @@ Fl_Scroll::Fl_Scroll(int X,int Y,int W,int H,const char* L)
   xposition_ = oldx = 0;
   yposition_ = oldy = 0;
   scrollbar_size_ = 0;
+#if FLTK_ABI_VERSION >= 10304
+  lazy_ = 0;
+#endif
   hscrollbar.type(FL_HORIZONTAL);
   hscrollbar.callback(hscrollbar_cb);
   scrollbar.callback(scrollbar_cb);
 }
 
+#if FLTK_ABI_VERSION >= 10304
+
+Fl_Scroll::~Fl_Scroll() {
+  delete lazy_;
+  lazy_ = 0;
+}
+
+#endif
+
 int Fl_Scroll::handle(int event) {
   fix_scrollbar_order();
+#if FLTK_ABI_VERSION >= 10304
+  if (lazy_) lazy_update();
+#endif
   return Fl_Group::handle(event);
 }
 
+#if FLTK_ABI_VERSION >= 10304
+
+/**
+  Turns lazy scrolling on or off.
+
+  Normally scroll_to() moves every child of the Fl_Scroll, which takes
+  a long time if there are many thousands of them. With lazy scrolling
+  only the children that are visible before or after scrolling are
+  moved, so the time it takes depends on the number of visible children.
+  Drawing also only visits these children, and the bounding box of the
+  children is remembered instead of being computed in every draw().
+
+  The children that are not visible are left where they were and their
+  x() and y() are not up to date. A child that is resized or added while
+  lazy scrolling is on is assumed to be positioned for the current
+  scroll position, like when it is off. Turning lazy scrolling off moves
+  all children to their proper positions.
+
+  This is an adaptation of scrolling by translation, where the children
+  keep their positions and the scroll offset is applied when they are
+  drawn and get events. FLTK 1.3 widgets draw themselves at their x()
+  and y(), so the visible children still have to be moved.
+
+  The cost of scrolling, and of moving or resizing the Fl_Scroll with
+  resize(), depends on the number of visible children and grows only
+  with the logarithm of the number of children. Adding a child costs
+  little. After a child was removed or resized, or many were added, the
+  sorted boxes of all children are rebuilt when the Fl_Scroll is next
+  drawn, scrolled or gets an event, which takes O(n log n) time for n
+  children.
+
+  \note Availability in FLTK_ABI_VERSION 10304 or higher.
+*/
+void Fl_Scroll::lazy_scroll(int on) {
+  if (on && !lazy_) {
+    lazy_ = new Fl_Scroll_Lazy;
+  } else if (!on && lazy_) {
+    lazy_update();
+    Fl_Scroll_Lazy *lazy = lazy_;
+    lazy_ = 0;
+    int dx = lazy->cx - lazy->bx, dy = lazy->cy - lazy->by;
+    if (dx || dy) {
+      for (int i = 0; i < children(); i++) {
+        Fl_Widget *o = child(i);
+        if (o == &scrollbar || o == &hscrollbar || lazy->placed.contains(o)) continue;
+        o->position(o->x() + dx, o->y() + dy);
+      }
+    }
+    delete lazy;
+  }
+}
+
+/**
+  Returns non-zero if lazy scrolling is on.
+  \see lazy_scroll(int)
+*/
+int Fl_Scroll::lazy_scroll() const {
+  return lazy_ != 0;
+}
+
+// Makes sure that all visible children are placed, after children or
+// the size of the Fl_Scroll have changed.
+void Fl_Scroll::lazy_update() {
+  if (!lazy_->dirty) return;
+  int X = x() + Fl::box_dx(box()), Y = y() + Fl::box_dy(box());
+  int W = w() - Fl::box_dw(box()), H = h() - Fl::box_dh(box());
+  lazy_->rebuild(this, X, Y, W, H);
+  lazy_->move(lazy_->cx, lazy_->cy, X, Y, W, H);
+}
+
+// Scrolls the placed children by dx, dy.
+void Fl_Scroll::lazy_move(int dx, int dy) {
+  lazy_update();
+  int X = x() + Fl::box_dx(box()), Y = y() + Fl::box_dy(box());
+  int W = w() - Fl::box_dw(box()), H = h() - Fl::box_dh(box());
+  lazy_->move(lazy_->cx + dx, lazy_->cy + dy, X, Y, W, H);
+}
+
+void Fl_Scroll::child_changed(Fl_Widget *o, int what) {
+  Fl_Group::child_changed(o, what);
+  // the scrollbars are added before lazy_ is initialized:
+  if (o == &scrollbar || o == &hscrollbar) return;
+  if (!lazy_ || lazy_->moving) return;
+  if (what == CHILD_LABEL) { // a label outside of the box is always placed
+    if (lazy_->dirty || !outside_label(o)) return;
+    lazy_->always.sort();
+    if (!lazy_->always.contains(o)) lazy_->dirty = 1;
+    return;
+  }
+  if (what == CHILD_REMOVED) {
+    lazy_->dirty = 1;
+    return;
+  }
+  lazy_->placed.add(o); // it is where it should be now
+  lazy_->norder = -1;
+  if (what == CHILD_ADDED) lazy_->add_box(o);
+  else lazy_->dirty = 1;
+}
+
+#endif // FLTK_ABI_VERSION >= 10304
+
 //
 // End of "$Id$".
 //
@@ -269,6 +269,7 @@ Fl_Scrollbar::Fl_Scrollbar(int X, int Y, int W, int H, const char* L)
   linesize_ = 16;
   pushed_ = 0;
   step(1);
+  set_flag(SHORTCUT_HANDLER); // it uses the arrow keys
 }
 
 /**  Destroys the Scrollbar. */
@@ -0,0 +1,290 @@
+//
+// "$Id$"
+//
+// Shortcut index for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2016 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Window.H>
+#include <FL/fl_utf8.h>
+#include "Fl_Shortcut_Index.H"
+#include <ctype.h>
+#include <stdlib.h>
+
+int Fl_Shortcut_Index::collecting = 0;
+Fl_Shortcut_Index *Fl_Shortcut_Index::current = 0;
+
+/**
+  Tells FLTK that a shortcut may have changed.
+
+  This must be called after changing the shortcut or the text of an
+  Fl_Menu_Item directly, if the menu is in a window that uses
+  Fl_Window::shortcut_index(). Changes made with the methods of the
+  widgets, e.g. Fl_Button::shortcut(int), label() or Fl_Menu_::add(),
+  call this already.
+
+  Only the index of the window that contains this widget is built again,
+  so changing the label of a widget in one window does not slow down
+  the shortcuts of the others.
+*/
+void Fl_Widget::shortcuts_changed() {
+  Fl_Shortcut_Index::changed(top_window());
+}
+
+// Keys are stored ignoring the case, the widget tests the case itself:
+static unsigned int fold(unsigned int key) {
+  return key < 128 ? (unsigned int)tolower(key) : key;
+}
+
+static int compare_entries(const void *a, const void *b) {
+  unsigned int ka = ((const Fl_Shortcut_Index::Entry*)a)->key;
+  unsigned int kb = ((const Fl_Shortcut_Index::Entry*)b)->key;
+  return ka < kb ? -1 : ka > kb;
+}
+
+static int compare_pairs(const void *a, const void *b) {
+  const Fl_Shortcut_Index::Pair *pa = (const Fl_Shortcut_Index::Pair*)a;
+  const Fl_Shortcut_Index::Pair *pb = (const Fl_Shortcut_Index::Pair*)b;
+  if (pa->parent != pb->parent) return pa->parent < pb->parent ? -1 : 1;
+  return pa->pos - pb->pos;
+}
+
+// Marks the index of window t to be built again, if it has one:
+void Fl_Shortcut_Index::changed(Fl_Window *t) {
+#if FLTK_ABI_VERSION >= 10304
+  if (t && t->shortcut_index_) t->shortcut_index_->dirty = 1;
+#else
+  (void)t;
+#endif
+}
+
+Fl_Shortcut_Index::Fl_Shortcut_Index(Fl_Window *w) {
+  window = w;
+  dirty = 1;
+  entries = 0; nentries = aentries = 0;
+  all = 0; nall = aall = 0;
+  pairs = 0; npairs = apairs = 0;
+  plan_valid = 0;
+  probed = 0;
+}
+
+Fl_Shortcut_Index::~Fl_Shortcut_Index() {
+  if (current == this) current = 0;
+  free(entries);
+  free(all);
+  free(pairs);
+}
+
+// Called by Fl::test_shortcut() and Fl_Widget::test_shortcut() while
+// the index is built. \p mods are the Ctrl, Alt and Meta keys that must
+// be held down, or ~0 if they don't matter:
+void Fl_Shortcut_Index::record(unsigned int key, unsigned int mods) {
+  if (!probed || !key) return;
+  key = fold(key);
+  // a widget usually tests the same key only once, but menus may not:
+  for (int i = nentries; i-- && entries[i].widget == probed;)
+    if (entries[i].key == key && entries[i].mods == mods) return;
+  if (nentries >= aentries) {
+    aentries = aentries ? 2 * aentries : 64;
+    entries = (Entry*)realloc((void*)entries, aentries * sizeof(Entry));
+  }
+  entries[nentries].key = key;
+  entries[nentries].mods = mods;
+  entries[nentries].widget = probed;
+  nentries++;
+}
+
+void Fl_Shortcut_Index::add_all(Fl_Widget *o) {
+  if (nall >= aall) {
+    aall = aall ? 2 * aall : 16;
+    all = (Fl_Widget**)realloc((void*)all, aall * sizeof(Fl_Widget*));
+  }
+  all[nall++] = o;
+}
+
+// Asks a widget and its children which keys they test:
+void Fl_Shortcut_Index::collect(Fl_Widget *o) {
+  if (o->flags() & Fl_Widget::SHORTCUT_HANDLER) {
+    add_all(o);
+  } else {
+    int n = nentries;
+    probed = o;
+    if (o->handle(FL_SHORTCUT)) {
+      // it does not say which keys it wants, so give it all of them:
+      nentries = n;
+      add_all(o);
+    }
+    probed = 0;
+  }
+  Fl_Group *g = o->as_group();
+  if (g) for (int i = 0; i < g->children(); i++) collect(g->child(i));
+}
+
+void Fl_Shortcut_Index::rebuild() {
+  dirty = 0;
+  nentries = nall = 0;
+  plan_valid = 0;
+  // send a keystroke that does not match anything:
+  int save_number = Fl::e_number, save_state = Fl::e_state;
+  int save_keysym = Fl::e_keysym, save_length = Fl::e_length;
+  char *save_text = Fl::e_text;
+  static char empty[1] = "";
+  Fl::e_number = FL_SHORTCUT;
+  Fl::e_state = 0;
+  Fl::e_keysym = 0;
+  Fl::e_text = empty;
+  Fl::e_length = 0;
+  Fl_Shortcut_Index *save_current = current;
+  current = this;
+  collecting++;
+  Fl_Group *g = window->as_group();
+  for (int i = 0; i < g->children(); i++) collect(g->child(i));
+  collecting--;
+  current = save_current;
+  Fl::e_number = save_number;
+  Fl::e_state = save_state;
+  Fl::e_keysym = save_keysym;
+  Fl::e_text = save_text;
+  Fl::e_length = save_length;
+  qsort(entries, nentries, sizeof(Entry), compare_entries);
+}
+
+// Adds a widget and its parents up to the window to the children to visit:
+void Fl_Shortcut_Index::add_pairs(Fl_Widget *o) {
+  for (; o != window && o->parent(); o = o->parent()) {
+    if (npairs >= apairs) {
+      apairs = apairs ? 2 * apairs : 64;
+      pairs = (Pair*)realloc((void*)pairs, apairs * sizeof(Pair));
+    }
+    pairs[npairs].parent = o->parent();
+    pairs[npairs].pos = o->parent()->find(o);
+    pairs[npairs].child = o;
+    npairs++;
+  }
+}
+
+// Adds the widgets that test a key:
+void Fl_Shortcut_Index::add_key(unsigned int key) {
+  if (!key) return;
+  key = fold(key);
+  int lo = 0, hi = nentries;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (entries[mid].key < key) lo = mid + 1; else hi = mid;
+  }
+  unsigned int mods = Fl::event_state() & (FL_META|FL_ALT|FL_CTRL);
+  for (; lo < nentries && entries[lo].key == key; lo++)
+    if (entries[lo].mods == mods || entries[lo].mods == ~0U) add_pairs(entries[lo].widget);
+}
+
+// Finds the children each group must visit for the current keystroke:
+void Fl_Shortcut_Index::plan() {
+  unsigned int c = fl_utf8decode(Fl::event_text(), Fl::event_text() + Fl::event_length(), 0);
+  if (dirty) rebuild();
+  else if (plan_valid && plan_key == Fl::event_key() &&
+           plan_char == (int)c && plan_state == Fl::event_state()) return;
+  plan_valid = 1;
+  plan_key = Fl::event_key();
+  plan_char = c;
+  plan_state = Fl::event_state();
+  npairs = 0;
+  // Fl_Group::handle() moves the focus with the Enter key:
+  plan_full = plan_key == FL_Enter || plan_key == FL_KP_Enter;
+  if (plan_full) return;
+  // these are the keys Fl::test_shortcut() and Fl_Widget::test_shortcut() accept:
+  add_key(plan_key);
+  add_key(c);
+  if (Fl::event_state(FL_CTRL)) add_key(c ^ 0x40);
+  for (int i = 0; i < nall; i++) add_pairs(all[i]);
+  qsort(pairs, npairs, sizeof(Pair), compare_pairs);
+  int n = 0;
+  for (int i = 0; i < npairs; i++)
+    if (!n || compare_pairs(pairs + i, pairs + n - 1)) pairs[n++] = pairs[i];
+  npairs = n;
+}
+
+/*
+  Returns the \p n children of \p g in \p list that may use the current
+  keystroke as a shortcut, in stacking order. Returns 0 if all children
+  must get it, e.g. because the window of \p g has no index.
+*/
+int Fl_Shortcut_Index::children(const Fl_Group *g, const Pair *&list, int &n) {
+#if FLTK_ABI_VERSION >= 10304
+  Fl_Window *t = ((Fl_Group*)g)->top_window();
+  if (!t || !t->shortcut_index_) return 0;
+  Fl_Shortcut_Index *index = t->shortcut_index_;
+  index->plan();
+  if (index->plan_full) return 0;
+  // the pairs of g are a range of the sorted array:
+  int lo = 0, hi = index->npairs;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (index->pairs[mid].parent < g) lo = mid + 1; else hi = mid;
+  }
+  list = index->pairs + lo;
+  for (n = 0; lo + n < index->npairs && list[n].parent == g; n++) {
+    // the children were moved without telling the index, e.g. by
+    // rearranging the array() of a group:
+    int pos = list[n].pos;
+    if (pos >= g->children() || g->child(pos) != list[n].child) {
+      index->dirty = 1;
+      return 0;
+    }
+  }
+  return 1;
+#else
+  return 0;
+#endif
+}
+
+#if FLTK_ABI_VERSION >= 10304 || defined(FL_DOXYGEN)
+
+/**
+  Turns the shortcut index of the window on or off.
+
+  Normally an FL_SHORTCUT event is sent to every widget of the window,
+  until one of them uses it. This takes a long time in windows with
+  hundreds of widgets or menus with thousands of items. With the index,
+  the window remembers which keys each widget tests with
+  Fl::test_shortcut() or Fl_Widget::test_shortcut(), and only sends the
+  event to the widgets that test the key. The index is built again
+  after any change of the window's widget tree, or of a label or a
+  shortcut in the window.
+
+  FLTK can not find out which keys a handle() method uses, if it does
+  not use these functions. Widgets of classes that test Fl::event_key()
+  or Fl::event_text() themselves in FL_SHORTCUT must have the
+  Fl_Widget::SHORTCUT_HANDLER flag set, so that they get all FL_SHORTCUT
+  events. FLTK does this for its own widgets, e.g. Fl_Return_Button.
+  Widgets that return non-zero for an FL_SHORTCUT event that does not
+  match anything get all events, too.
+
+  If the shortcut or the text of a menu item is changed directly through
+  an Fl_Menu_Item pointer, call shortcuts_changed() of the menu widget.
+
+  The index is off by default.
+
+  \note Availability in FLTK_ABI_VERSION 10304 or higher.
+*/
+void Fl_Window::shortcut_index(int on) {
+  if (on && !shortcut_index_) shortcut_index_ = new Fl_Shortcut_Index(this);
+  else if (!on && shortcut_index_) {delete shortcut_index_; shortcut_index_ = 0;}
+}
+
+#endif
+
+//
+// End of "$Id$".
+//
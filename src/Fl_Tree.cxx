@@ -29,7 +29,11 @@
 
 // INTERNAL: scroller callback (hor+vert scroll)
 static void scroll_cb(Fl_Widget*,void *data) {
+#if FLTK_ABI_VERSION >= 10304
+  ((Fl_Tree*)data)->damage(FL_DAMAGE_SCROLL);	// draw() moves what is still visible
+#else
   ((Fl_Tree*)data)->redraw();
+#endif
 }
 
 // INTERNAL: Parse elements from 'path' into an array of null terminated strings
@@ -62,6 +66,24 @@ static void free_path(char **arr) {
   }
 }
 
+#if FLTK_ABI_VERSION >= 10304
+// INTERNAL: Return where the last element of 'path' starts,
+//    using the same rules as parse_path().
+//    Path="/aa/bb", returns "bb". Path="/aa/bb/", returns "bb/".
+//
+static const char *last_path_element(const char *path) {
+  const char *last = 0;
+  int inword = 0;
+  while ( *path ) {
+    if ( *path == '/' ) { inword = 0; path++; continue; }	// path sep
+    if ( *path == '\\' && !*(path+1) ) break;		// escape at eos: ignored
+    if ( !inword ) { last = path; inword = 1; }
+    path += (*path == '\\') ? 2 : 1;			// skip escaped char too
+  }
+  return last ? last : path;
+}
+#endif
+
 #if 0		/* unused code -- STR #3169 */
 // INTERNAL: Recursively descend 'item's tree hierarchy
 //           accumulating total child 'count'
@@ -117,6 +139,12 @@ Fl_Tree::Fl_Tree(int X, int Y, int W, int H, const char *L) : Fl_Group(X,Y,W,H,L
   _toh = _tih = H - Fl::box_dh(box());
   _tree_w = -1;
   _tree_h = -1;
+#endif
+#if FLTK_ABI_VERSION >= 10304
+  _scroll_x = 0;
+  _scroll_y = 0;
+  _add_parent = 0;
+  _add_prefix = 0;
 #endif
   end();
 }
@@ -124,6 +152,9 @@ Fl_Tree::Fl_Tree(int X, int Y, int W, int H, const char *L) : Fl_Group(X,Y,W,H,L
 /// Destructor.
 Fl_Tree::~Fl_Tree() {
   if ( _root ) { delete _root; _root = 0; }
+#if FLTK_ABI_VERSION >= 10304
+  if ( _add_prefix ) { free(_add_prefix); _add_prefix = 0; }
+#endif
 }
 
 /// Extend the selection between and including \p 'from' and \p 'to'
@@ -371,8 +402,8 @@ int Fl_Tree::handle(int e) {
 	      set_item_focus(next_visible_item(_item_focus, ekey));	// next item up|dn
 	      if ( _item_focus ) {					// item in focus?
 	        // Autoscroll
-		int itemtop = _item_focus->y();
-		int itembot = _item_focus->y()+_item_focus->h();
+		int itemtop = _item_focus->layout_y();
+		int itembot = _item_focus->layout_y()+_item_focus->h();
 		if ( itemtop < y() ) { show_item_top(_item_focus); }
 		if ( itembot > y()+h() ) { show_item_bottom(_item_focus); }
 		// Extend selection
@@ -559,7 +590,7 @@ int Fl_Tree::handle(int e) {
             Fl::event_x() >= item->label_x()) {
           //printf("Would drag '%s' to '%s'\n", _lastselect->label(), item->label());
           // Are we dropping above or below the target item?
-          const int h = Fl::event_y() - item->y();
+          const int h = Fl::event_y() - item->layout_y();
           const int mid = item->h() / 2;
           const bool before = h < mid;
           //printf("Dropping %s it\n", before ? "before" : "after");
@@ -765,15 +796,78 @@ void Fl_Tree::resize(int X,int Y,int W, int H) {
   init_sizes();
 }
 
+#if FLTK_ABI_VERSION >= 10304
+// Draw the items of the tree, clipped to the tree's inner area.
+void Fl_Tree::draw_items() {
+  // These values are changed during drawing
+  // By end, 'Y' will be the lowest point on the tree
+  int X = _tix + _prefs.marginleft() - _hscroll->value();
+  int Y = _tiy + _prefs.margintop()  - _vscroll->value();
+  int W = _tiw - X + _tix;
+  // Adjust root's X/W if connectors off
+  if (_prefs.connectorstyle() == FL_TREE_CONNECTOR_NONE) {
+    X -= _prefs.openicon()->w();
+    W += _prefs.openicon()->w();
+  }
+  // Draw entire tree, starting with root
+  fl_push_clip(_tix,_tiy,_tiw,_tih);
+  {
+    int xmax = 0;
+    fl_font(_prefs.labelfont(), _prefs.labelsize());
+    _root->draw(X, Y, W, 				// descend into tree here to draw it
+		(Fl::focus()==this)?_item_focus:0,	// show focus item ONLY if Fl_Tree has focus
+		xmax, 1, 1);
+  }
+  fl_pop_clip();
+}
+
+// INTERNAL: fl_scroll() callback, draws the part of the tree scrolled into view
+void Fl_Tree::draw_area_cb(void *v, int X, int Y, int W, int H) {
+  Fl_Tree *tree = (Fl_Tree*)v;
+  fl_push_clip(X,Y,W,H);
+  fl_color(tree->color());
+  fl_rectf(X,Y,W,H);
+  tree->draw_items();
+  fl_pop_clip();
+}
+#endif
+
 #if FLTK_ABI_VERSION >= 10303
 /// Standard FLTK draw() method, handles drawing the tree widget.
 void Fl_Tree::draw() {
   fix_scrollbar_order();
+#if FLTK_ABI_VERSION >= 10304
+  // Only scrolled? Then move what is still visible with fl_scroll(), unless
+  // the tree must be measured again, or the drag line would be moved too.
+  int scrolled = (damage() & FL_DAMAGE_SCROLL) &&
+                 !(damage() & ~(FL_DAMAGE_SCROLL|FL_DAMAGE_CHILD)) &&
+                 _tree_w != -1 && _root &&
+		 box() != FL_NO_BOX && fl_box(box()) == box() &&
+		 !(_prefs.selectmode() == FL_TREE_SELECT_SINGLE_DRAGGABLE &&
+		   Fl::pushed() == this);
+#endif
   // Has tree recalc been scheduled? If so, do it
   if ( _tree_w == -1 ) calc_tree();
   else calc_dimensions();
   // Let group draw box+label but *NOT* children.
   // We handle drawing children ourselves by calling each item's draw()
+#if FLTK_ABI_VERSION >= 10304
+  if ( scrolled ) {
+    fl_scroll(_tix, _tiy, _tiw, _tih,
+              _scroll_x - (int)_hscroll->value(), _scroll_y - (int)_vscroll->value(),
+              draw_area_cb, this);
+  } else {
+    // Draw group's bg + label
+    if ( damage() & ~FL_DAMAGE_CHILD) {	// redraw entire widget?
+      Fl_Group::draw_box();
+      Fl_Group::draw_label();
+    }
+    if ( ! _root ) return;
+    draw_items();
+  }
+  _scroll_x = (int)_hscroll->value();
+  _scroll_y = (int)_vscroll->value();
+#else
   {
     // Draw group's bg + label
     if ( damage() & ~FL_DAMAGE_CHILD) {	// redraw entire widget?
@@ -802,6 +896,7 @@ void Fl_Tree::draw() {
     }
     fl_pop_clip();
   }  
+#endif
   // Draw scrollbars last
   draw_child(*_vscroll);
   draw_child(*_hscroll);
@@ -821,13 +916,13 @@ void Fl_Tree::draw() {
     Fl_Tree_Item *item = _root->find_clicked(_prefs, 1); // item we're on, vertically
     if (item && item != _item_focus) {
       // Are we dropping above or before the target item?
-      const int h = Fl::event_y() - item->y();
+      const int h = Fl::event_y() - item->layout_y();
       const int mid = item->h() / 2;
       const bool before = h < mid;
 
       fl_color(FL_BLACK);
 
-      int tgt = item->y() + (before ? 0 : item->h());
+      int tgt = item->layout_y() + (before ? 0 : item->h());
       fl_line(item->x(), tgt, item->x() + item->w(), tgt);
     }
   }
@@ -1021,11 +1116,39 @@ Fl_Tree_Item* Fl_Tree::add(const char *path, Fl_Tree_Item *item) {
     _root->parent(0);
     _root->label("ROOT");
   } 
+#if FLTK_ABI_VERSION >= 10304
+  // Find parent item via path. Paths are often added in order (e.g. when
+  // loading a directory listing), so the parent of the last path added
+  // is remembered, and used again if this path has the same one.
+  const char *name = last_path_element(path);
+  int len = int(name - path);
+  if ( !_add_parent || !_add_prefix ||
+       strncmp(_add_prefix, path, len) != 0 || _add_prefix[len] != 0 ) {
+    char *prefix = (char*)malloc(len+1);
+    memcpy(prefix, path, len);
+    prefix[len] = 0;
+    char **arr = parse_path(prefix);
+    Fl_Tree_Item *parent = _root;
+    for ( int t=0; arr[t]; t++ ) {		// make missing parents
+      Fl_Tree_Item *child = parent->find_child_item(arr[t]);
+      parent = child ? child : parent->add(_prefs, arr[t]);
+    }
+    free_path(arr);
+    if ( _add_prefix ) free(_add_prefix);
+    _add_prefix = prefix;
+    _add_parent = parent;
+  }
+  char **arr = parse_path(name);
+  item = _add_parent->add(_prefs, arr, item);
+  free_path(arr);
+  return(item);
+#else
   // Find parent item via path
   char **arr = parse_path(path);
   item = _root->add(_prefs, arr, item);
   free_path(arr);
   return(item);
+#endif
 }
 
 #if FLTK_ABI_VERSION >= 10303
@@ -2593,7 +2716,7 @@ void Fl_Tree::item_draw_mode(int mode) {
 int Fl_Tree::displayed(Fl_Tree_Item *item) {
   item = item ? item : first();
   if (!item) return(0);
-  return( (item->y() >= y()) && (item->y() <= (y()+h()-item->h())) ? 1 : 0);
+  return( (item->layout_y() >= y()) && (item->layout_y() <= (y()+h()-item->h())) ? 1 : 0);
 }
 
 /// Adjust the vertical scroll bar so that \p 'item' is visible
@@ -2613,7 +2736,7 @@ int Fl_Tree::displayed(Fl_Tree_Item *item) {
 void Fl_Tree::show_item(Fl_Tree_Item *item, int yoff) {
   item = item ? item : first();
   if (!item) return;
-  int newval = item->y() - y() - yoff + (int)_vscroll->value();
+  int newval = item->layout_y() - y() - yoff + (int)_vscroll->value();
   if ( newval < _vscroll->minimum() ) newval = (int)_vscroll->minimum();
   if ( newval > _vscroll->maximum() ) newval = (int)_vscroll->maximum();
   _vscroll->value(newval);
@@ -2697,7 +2820,11 @@ void Fl_Tree::vposition(int pos) {
   if (pos > _vscroll->maximum()) pos = (int)_vscroll->maximum();
   if (pos == _vscroll->value()) return;
   _vscroll->value(pos);
+#if FLTK_ABI_VERSION >= 10304
+  damage(FL_DAMAGE_SCROLL);
+#else
   redraw();
+#endif
 }
 
 /// Returns the horizontal scroll position as a pixel offset.
@@ -2726,8 +2853,12 @@ void Fl_Tree::hposition(int pos) {
   if (pos > _hscroll->maximum()) pos = (int)_hscroll->maximum();
   if (pos == _hscroll->value()) return;
   _hscroll->value(pos);
+#if FLTK_ABI_VERSION >= 10304
+  damage(FL_DAMAGE_SCROLL);
+#else
   redraw();
 #endif
+#endif
 }
 
 /// See if widget \p 'w' is one of the Fl_Tree widget's scrollbars.
@@ -2946,6 +3077,9 @@ void Fl_Tree::recalc_tree() {
 #if FLTK_ABI_VERSION >= 10303
   _tree_w = _tree_h = -1;
 #endif
+#if FLTK_ABI_VERSION >= 10304
+  if ( _root ) _root->clear_layout();	// e.g. prefs changed: measure all items again
+#endif
 }
 
 //
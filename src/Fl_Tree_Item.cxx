@@ -90,6 +90,11 @@ void Fl_Tree_Item::_Init(const Fl_Tree_Prefs &prefs, Fl_Tree *tree) {
   _prev_sibling     = 0;
   _next_sibling     = 0;
 #endif /*FLTK_ABI_VERSION*/
+#if FLTK_ABI_VERSION >= 10304
+  _subtree_h        = -1;
+  _subtree_w        = 0;
+  _subtree_y        = 0;
+#endif
 }
 
 #if FLTK_ABI_VERSION >= 10303
@@ -121,6 +126,11 @@ Fl_Tree_Item::~Fl_Tree_Item() {
   // focus item? set to null
   if ( _tree && this == _tree->_item_focus )
     { _tree->_item_focus = 0; }
+#endif
+#if FLTK_ABI_VERSION >= 10304
+  // parent of the last path added? forget it
+  if ( _tree && this == _tree->_add_parent )
+    { _tree->_add_parent = 0; }
 #endif
   //_children.clear();		// array's destructor handles itself
 }
@@ -163,6 +173,11 @@ Fl_Tree_Item::Fl_Tree_Item(const Fl_Tree_Item *o) {
   _prev_sibling     = 0;		// do not copy ptrs! use update_prev_next()
   _next_sibling     = 0;		// do not copy ptrs! use update_prev_next()
 #endif /*FLTK_ABI_VERSION*/
+#if FLTK_ABI_VERSION >= 10304
+  _subtree_h        = -1;		// the children are not copied
+  _subtree_w        = 0;
+  _subtree_y        = 0;
+#endif
 }
 
 /// Print the tree as 'ascii art' to stdout.
@@ -194,8 +209,16 @@ void Fl_Tree_Item::show_self(const char *indent) const {
 /// Makes and manages an internal copy of \p 'name'.
 ///
 void Fl_Tree_Item::label(const char *name) {
+#if FLTK_ABI_VERSION >= 10304
+  // Keep our parent's index of its children's labels up to date
+  int indexed = _parent ? _parent->_children.index_remove(this) : 0;
+  if ( _parent ) forget_paths();
+#endif
   if ( _label ) { free((void*)_label); _label = 0; }
   _label = name ? strdup(name) : 0;
+#if FLTK_ABI_VERSION >= 10304
+  if ( indexed ) _parent->_children.index_add(this);
+#endif
   recalc_tree();		// may change label geometry
 }
 
@@ -222,6 +245,10 @@ void Fl_Tree_Item::clear_children() {
 /// \version 1.3.0 release
 ///
 int Fl_Tree_Item::find_child(const char *name) {
+#if FLTK_ABI_VERSION >= 10304
+  Fl_Tree_Item *item = name ? _children.find_label(name) : 0;
+  return(item ? find_child(item) : -1);
+#else
   if ( name ) {
     for ( int t=0; t<children(); t++ )
       if ( child(t)->label() )
@@ -229,21 +256,31 @@ int Fl_Tree_Item::find_child(const char *name) {
           return(t);
   }
   return(-1);
+#endif
 }
 
 /// Return the /immediate/ child of current item
 /// that has the label \p 'name'.
 ///
+/// With the 1.3.4 ABI, items with many children keep a hash table
+/// of the labels of their children, so this does not compare the
+/// label of every child.
+///
 /// \returns const found item, or 0 if not found.
 /// \version 1.3.3
 ///
 const Fl_Tree_Item* Fl_Tree_Item::find_child_item(const char *name) const {
+#if FLTK_ABI_VERSION >= 10304
+  // find_label() may build the index of the labels of our children
+  return(name ? const_cast<Fl_Tree_Item_Array&>(_children).find_label(name) : 0);
+#else
   if ( name )
     for ( int t=0; t<children(); t++ )
       if ( child(t)->label() )
         if ( strcmp(child(t)->label(), name) == 0 )
           return(child(t));
   return(0);
+#endif
 }
 
 /// Non-const version of Fl_Tree_Item::find_child_item(const char *name) const.
@@ -261,6 +298,11 @@ Fl_Tree_Item* Fl_Tree_Item::find_child_item(const char *name) {
 /// \version 1.3.0 release
 ///
 const Fl_Tree_Item *Fl_Tree_Item::find_child_item(char **arr) const {
+#if FLTK_ABI_VERSION >= 10304
+  const Fl_Tree_Item *item = find_child_item(*arr);
+  if ( !item ) return(0);
+  return(*(arr+1) ? item->find_child_item(arr+1) : item);	// more in arr? descend
+#else
   for ( int t=0; t<children(); t++ ) {
     if ( child(t)->label() ) {
       if ( strcmp(child(t)->label(), *arr) == 0 ) {	// match?
@@ -273,6 +315,7 @@ const Fl_Tree_Item *Fl_Tree_Item::find_child_item(char **arr) const {
     }
   }
   return(0);
+#endif
 }
 
 /// Non-const version of Fl_Tree_Item::find_child_item(char **arr) const.
@@ -445,6 +488,9 @@ Fl_Tree_Item *Fl_Tree_Item::insert(const Fl_Tree_Prefs &prefs, const char *new_l
   item->_parent = this;
   _children.insert(pos, item);
   recalc_tree();		// may change tree geometry
+#if FLTK_ABI_VERSION >= 10304
+  forget_paths();		// may change the item that a path leads to
+#endif
   return(item);
 }
 
@@ -479,6 +525,10 @@ Fl_Tree_Item *Fl_Tree_Item::insert_above(const Fl_Tree_Prefs &prefs, const char
 Fl_Tree_Item* Fl_Tree_Item::deparent(int pos) {
   Fl_Tree_Item *orphan = _children[pos];
   if ( _children.deparent(pos) < 0 ) return NULL;
+  recalc_tree();		// may change tree geometry
+#if FLTK_ABI_VERSION >= 10304
+  forget_paths();		// may change the item that a path leads to
+#endif
   return orphan;
 }
 
@@ -493,6 +543,10 @@ int Fl_Tree_Item::reparent(Fl_Tree_Item *newchild, int pos) {
   int ret;
   if ( (ret = _children.reparent(newchild, this, pos)) < 0 ) return ret;
   newchild->parent(this);		// take custody
+  recalc_tree();		// may change tree geometry
+#if FLTK_ABI_VERSION >= 10304
+  forget_paths();		// may change the item that a path leads to
+#endif
   return 0;
 }
 
@@ -504,7 +558,12 @@ int Fl_Tree_Item::reparent(Fl_Tree_Item *newchild, int pos) {
 ///    - (Other return values reserved for future use)
 ///
 int Fl_Tree_Item::move(int to, int from) {
-  return _children.move(to, from);
+  int ret = _children.move(to, from);
+  recalc_tree();		// may change tree geometry
+#if FLTK_ABI_VERSION >= 10304
+  forget_paths();		// may change the item that a path leads to
+#endif
+  return ret;
 }
 
 /// Move the current item above/below/into the specified 'item',
@@ -657,6 +716,9 @@ Fl_Tree_Item *Fl_Tree_Item::replace_child(Fl_Tree_Item *olditem,
   // replace in array (handles stitching neighboring items)
   _children.replace(pos, newitem);
   recalc_tree();			// newitem may have changed tree geometry
+#if FLTK_ABI_VERSION >= 10304
+  forget_paths();		// may change the item that a path leads to
+#endif
   return newitem;
 }
 #endif
@@ -704,6 +766,10 @@ int Fl_Tree_Item::remove_child(const char *name) {
 ///
 void Fl_Tree_Item::swap_children(int ax, int bx) {
   _children.swap(ax, bx);
+  recalc_tree();		// may change tree geometry
+#if FLTK_ABI_VERSION >= 10304
+  forget_paths();		// may change the item that a path leads to
+#endif
 }
 
 /// Swap two of our immediate children, given item pointers.
@@ -794,6 +860,9 @@ void Fl_Tree_Item::draw_vertical_connector(int x, int y1, int y2, const Fl_Tree_
 /// \version 1.3.3 ABI feature
 ///
 const Fl_Tree_Item *Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs &prefs, int yonly) const {
+#if FLTK_ABI_VERSION >= 10304
+  return(find_clicked_at(prefs, yonly, layout_y()));
+#else
   if ( ! is_visible() ) return(0);
   if ( is_root() && !prefs.showroot() ) {
     // skip event check if we're root but root not being shown
@@ -818,7 +887,57 @@ const Fl_Tree_Item *Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs &prefs, int y
     }
   }
   return(0);
+#endif
+}
+
+#if FLTK_ABI_VERSION >= 10304
+// Same as find_clicked(), but with the item's y position given in 'top'.
+// Uses the sizes remembered by draw() to only look at the children
+// near the event, instead of every item of the tree.
+//
+const Fl_Tree_Item *Fl_Tree_Item::find_clicked_at(const Fl_Tree_Prefs &prefs,
+						  int yonly, int top) const {
+  if ( ! is_visible() ) return(0);
+  int ey = Fl::event_y();
+  if ( is_root() && !prefs.showroot() ) {
+    // skip event check if we're root but root not being shown
+  } else {
+    // See if event is over us
+    if ( yonly ) {
+      if ( ey >= top && ey <= (top+_xywh[3]) ) {
+        return(this);
+      }
+    } else {
+      int xywh[4] = { _xywh[0], top, _xywh[2], _xywh[3] };
+      if ( event_inside(xywh) ) {		// event within this item?
+        return(this);				// found
+      }
+    }
+  }
+  if ( is_open() ) {				// open? check children of this item
+    int t = 0;
+    if ( _subtree_h >= 0 ) {
+      // Skip the children that end above the event
+      int lo = 0, hi = children();
+      while ( lo < hi ) {
+        int m = (lo + hi) / 2;
+	const Fl_Tree_Item *c = _children[m];
+	if ( (top + c->_subtree_y + c->_subtree_h) < ey ) lo = m + 1;
+	else hi = m;
+      }
+      t = lo;
+    }
+    for ( ; t<children(); t++ ) {
+      const Fl_Tree_Item *c = _children[t];
+      if ( _subtree_h >= 0 && (top + c->_subtree_y) > ey ) break;	// below the event
+      const Fl_Tree_Item *item;
+      if ( (item = c->find_clicked_at(prefs, yonly, top + c->_subtree_y)) != NULL )
+        return(item);
+    }
+  }
+  return(0);
 }
+#endif
 
 /// Non-const version of Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs&,int) const
 Fl_Tree_Item *Fl_Tree_Item::find_clicked(const Fl_Tree_Prefs &prefs, int yonly) {
@@ -1071,14 +1190,40 @@ int Fl_Tree_Item::draw_item_content(int render) {
 ///                               0: no rendering, just calculate size w/out drawing.
 ///                               1: render item as well as size calc
 ///
+/// With the 1.3.4 ABI, the height and width of the item and its children
+/// are remembered when render is 0, until recalc_tree() is called for the
+/// item or one of its children. The items scrolled out of view are then
+/// skipped when rendering, and their xywh are not updated.
+///
 /// \version 1.3.3 ABI feature: modified parameters
 ///
 void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Tree_Item *itemfocus,
 			int &tree_item_xmax, int lastchild, int render) {
   Fl_Tree_Prefs &prefs = _tree->_prefs;
+#if FLTK_ABI_VERSION >= 10304
+  if ( !is_visible() ) {
+    if ( !render ) { _subtree_h = 0; _subtree_w = 0; _flags &= ~HAS_WIDGETS; }
+    return;
+  }
+#else
   if ( !is_visible() ) return; 
+#endif
   int tree_top = tree()->_tiy;
   int tree_bot = tree_top + tree()->_tih;
+#if FLTK_ABI_VERSION >= 10304
+  // Skip this item and its children if we know their size, and they are
+  // out of view or are only being measured. Widgets are always moved.
+  if ( _subtree_h >= 0 &&
+       ( !render ||
+         ( !is_flag(HAS_WIDGETS) && ((Y+_subtree_h) < tree_top || Y > tree_bot) ) ) ) {
+    if ( _subtree_w && X + _subtree_w > tree_item_xmax )
+      tree_item_xmax = X + _subtree_w;
+    Y += _subtree_h;
+    return;
+  }
+  int Y0 = Y;
+  int widgets = widget() ? 1 : 0;
+#endif
   int H = calc_item_height(prefs);	// height of item
   int H2 = H + prefs.linespacing();	// height of item with line spacing
 
@@ -1249,16 +1394,46 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Tree_Item *itemfocus,
   // Manage tree_item_xmax
   if ( xmax > tree_item_xmax )
     tree_item_xmax = xmax;
+#if FLTK_ABI_VERSION >= 10304
+  int subtree_xmax = xmax;		// right edge of this item and its children
+  // Only look at the children in view if we know where they are
+  int skip = render && _subtree_h >= 0 && !is_flag(HAS_WIDGETS);
+#endif
   // Draw child items (if any)
   if ( has_children() && is_open() ) {
     int child_x = drawthis ? (hconn_x_center - (icon_w/2) + 1)	// offset children to right,
                            : X;					// unless didn't drawthis
     int child_w = W - (child_x-X);
     int child_y_start = Y;
+#if FLTK_ABI_VERSION >= 10304
+    int t = 0;
+    if ( skip ) {
+      // Find the first child that reaches into view
+      int lo = 0, hi = children();
+      while ( lo < hi ) {
+        int m = (lo + hi) / 2;
+	Fl_Tree_Item *c = _children[m];
+        if ( (Y0 + c->_subtree_y + c->_subtree_h) < tree_top ) lo = m + 1;
+	else hi = m;
+      }
+      t = lo;
+      if ( t < children() ) Y = Y0 + _children[t]->_subtree_y;
+    }
+    for ( ; t<children(); t++ ) {
+      if ( skip && Y > tree_bot ) break;	// the others are below the view
+      int lastchild = ((t+1)==children()) ? 1 : 0;
+      Fl_Tree_Item *c = _children[t];
+      if ( !skip ) c->_subtree_y = Y - Y0;
+      c->draw(child_x, Y, child_w, itemfocus, subtree_xmax, lastchild, render);
+      if ( c->is_visible() && c->is_flag(HAS_WIDGETS) ) widgets = 1;
+    }
+    if ( skip ) Y = Y0 + _subtree_h - prefs.openchild_marginbottom();
+#else
     for ( int t=0; t<children(); t++ ) {
       int lastchild = ((t+1)==children()) ? 1 : 0;
       _children[t]->draw(child_x, Y, child_w, itemfocus, tree_item_xmax, lastchild, render);
     }
+#endif
     if ( has_children() && is_open() ) {
       Y += prefs.openchild_marginbottom();		// offset below open child tree
     }
@@ -1270,6 +1445,18 @@ void Fl_Tree_Item::draw(int X, int &Y, int W, Fl_Tree_Item *itemfocus,
         draw_vertical_connector(hconn_x, child_y_start, Y, prefs);
     }
   }
+#if FLTK_ABI_VERSION >= 10304
+  if ( subtree_xmax > tree_item_xmax )
+    tree_item_xmax = subtree_xmax;
+  if ( !render ) {
+    // Remember our size for the next draw()
+    _subtree_h = Y - Y0;
+    _subtree_w = subtree_xmax > X ? subtree_xmax - X : 0;
+    if ( widgets ) _flags |= HAS_WIDGETS; else _flags &= ~HAS_WIDGETS;
+  } else if ( _subtree_h >= 0 ) {
+    _subtree_h = Y - Y0;		// a widget's height may have changed
+  }
+#endif
 }
 
 #else
@@ -1833,11 +2020,58 @@ int Fl_Tree_Item::visible_r() const {
 /// \version 1.3.3 ABI
 ///
 void Fl_Tree_Item::recalc_tree() {
-#if FLTK_ABI_VERSION >= 10303
+#if FLTK_ABI_VERSION >= 10304
+  // Only we and our parents need to be measured again
+  Fl_Tree_Item *p = this;
+  do {
+    p->_subtree_h = -1;
+    p = p->_parent;
+  } while ( p && p->_subtree_h >= 0 );
+  if ( _tree ) _tree->_tree_w = _tree->_tree_h = -1;
+#elif FLTK_ABI_VERSION >= 10303
   _tree->recalc_tree();
 #endif
 }
 
+#if FLTK_ABI_VERSION >= 10304
+// Call this when the path of items may have changed (label, order, parent).
+// Makes the tree forget the item that the last added path led to.
+//
+void Fl_Tree_Item::forget_paths() {
+  if ( _tree ) _tree->_add_parent = 0;
+}
+
+// Forget the size of this item and all of its children,
+// so that they are all measured again.
+//
+void Fl_Tree_Item::clear_layout() {
+  _subtree_h = -1;
+  for ( int t=0; t<children(); t++ )
+    _children[t]->clear_layout();
+}
+#endif
+
+/// Return the item's y position relative to the window, as laid out by
+/// the last draw() of the tree.
+///
+/// With the 1.3.4 ABI, items scrolled out of view are not drawn, so their
+/// y() may be out of date. This calculates the position from the root
+/// item's y() and the offsets of the items remembered by draw() instead,
+/// which takes time proportional to the depth of the item. Use it, rather
+/// than y(), for items that may be outside the visible area, e.g. to
+/// scroll to them. With older ABI versions this is the same as y().
+///
+/// \returns The item's y position in pixels.
+/// \see y(), Fl_Tree::show_item()
+/// \version 1.3.4
+///
+int Fl_Tree_Item::layout_y() const {
+#if FLTK_ABI_VERSION >= 10304
+  if ( _parent ) return(_parent->layout_y() + _subtree_y);
+#endif
+  return(_xywh[1]);
+}
+
 //
 // End of "$Id$".
 //
@@ -8,6 +8,7 @@
 
 #include <FL/Fl_Tree_Item_Array.H>
 #include <FL/Fl_Tree_Item.H>
+#include "Fl_Hash_Table.H"
 
 //////////////////////
 // Fl_Tree_Item_Array.cxx
@@ -27,6 +28,20 @@
 //     http://www.fltk.org/str.php
 //
 
+#if FLTK_ABI_VERSION >= 10304
+// Hash table of the labeled items of an array, so that Fl_Tree path
+// lookups don't have to compare the label of every child.
+// Only arrays with many items that are searched get one.
+//
+struct Fl_Tree_Item_Index : Fl_Hash_Table<Fl_Tree_Item*> {
+  static unsigned hash_label(const char *s) {
+    unsigned h = 2166136261U;		// FNV-1a
+    while ( *s ) { h ^= (unsigned char)*s++; h *= 16777619U; }
+    return h;
+  }
+};
+#endif
+
 /// Constructor; creates an empty array.
 ///
 ///     The optional 'chunksize' can be specified to optimize
@@ -38,6 +53,9 @@ Fl_Tree_Item_Array::Fl_Tree_Item_Array(int new_chunksize) {
   _size      = 0;
 #if FLTK_ABI_VERSION >= 10303
   _flags     = 0;
+#endif
+#if FLTK_ABI_VERSION >= 10304
+  _index     = 0;
 #endif
   _chunksize = new_chunksize;
 }
@@ -55,6 +73,9 @@ Fl_Tree_Item_Array::Fl_Tree_Item_Array(const Fl_Tree_Item_Array* o) {
   _chunksize = o->_chunksize;
 #if FLTK_ABI_VERSION >= 10303
   _flags     = o->_flags;
+#endif
+#if FLTK_ABI_VERSION >= 10304
+  _index     = 0;
 #endif
   for ( int t=0; t<o->_total; t++ ) {
 #if FLTK_ABI_VERSION >= 10303
@@ -92,6 +113,9 @@ void Fl_Tree_Item_Array::clear() {
     }
     free((void*)_items); _items = 0;
   }
+#if FLTK_ABI_VERSION >= 10304
+  delete _index; _index = 0;
+#endif
   _total = _size = 0;
 }
 
@@ -132,6 +156,9 @@ void Fl_Tree_Item_Array::insert(int pos, Fl_Tree_Item *new_item) {
   } 
   _items[pos] = new_item;
   _total++;
+#if FLTK_ABI_VERSION >= 10304
+  if ( _index ) index_add(new_item);
+#endif
 #if FLTK_ABI_VERSION >= 10303
   if ( _flags & MANAGE_ITEM )
 #endif
@@ -156,6 +183,12 @@ void Fl_Tree_Item_Array::add(Fl_Tree_Item *val) {
 /// and the new item will take it's place, and stitched into the linked list.
 ///
 void Fl_Tree_Item_Array::replace(int index, Fl_Tree_Item *newitem) {
+#if FLTK_ABI_VERSION >= 10304
+  if ( _index ) {
+    if ( _items[index] ) index_remove(_items[index]);
+    index_add(newitem);
+  }
+#endif
   if ( _items[index] ) {			// delete if non-zero
 #if FLTK_ABI_VERSION >= 10303
     if ( _flags & MANAGE_ITEM )
@@ -178,6 +211,9 @@ void Fl_Tree_Item_Array::replace(int index, Fl_Tree_Item *newitem) {
 ///     The item will be delete'd (if non-NULL), so its destructor will be called.
 ///
 void Fl_Tree_Item_Array::remove(int index) {
+#if FLTK_ABI_VERSION >= 10304
+  if ( _index && _items[index] ) index_remove(_items[index]);
+#endif
   if ( _items[index] ) {			// delete if non-zero
 #if FLTK_ABI_VERSION >= 10303
     if ( _flags & MANAGE_ITEM )
@@ -273,6 +309,9 @@ int Fl_Tree_Item_Array::deparent(int pos) {
   Fl_Tree_Item *item = _items[pos];
   Fl_Tree_Item *prev = item->prev_sibling();
   Fl_Tree_Item *next = item->next_sibling();
+#if FLTK_ABI_VERSION >= 10304
+  if ( _index ) index_remove(item);
+#endif
   // Remove from parent's list of children
   _total -= 1;
   for ( int t=pos; t<_total; t++ )
@@ -298,12 +337,59 @@ int Fl_Tree_Item_Array::reparent(Fl_Tree_Item *item, Fl_Tree_Item* newparent, in
   for ( int t=_total-1; t>pos; --t )    // shuffle array to make room for new entry
     _items[t] = _items[t-1];
   _items[pos] = item;                   // insert new entry
+#if FLTK_ABI_VERSION >= 10304
+  if ( _index ) index_add(item);
+#endif
   // Attach to new parent and siblings
   _items[pos]->parent(newparent);       // reparent (update_prev_next() needs this)
   _items[pos]->update_prev_next(pos);   // find new siblings
   return 0;
 }
 
+
+#if FLTK_ABI_VERSION >= 10304
+// Return the first of the 'total' items labeled 'name', or NULL
+static Fl_Tree_Item *find_first_label(Fl_Tree_Item **items, int total, const char *name) {
+  for ( int t=0; t<total; t++ )
+    if ( items[t]->label() && strcmp(items[t]->label(), name) == 0 )
+      return(items[t]);
+  return(0);
+}
+
+// Find the first item labeled 'name', using the hash table of the labels.
+// The table is only made once the array has enough items to be worth it.
+//
+Fl_Tree_Item *Fl_Tree_Item_Array::find_label(const char *name) {
+  if ( !_index ) {
+    if ( _total < 16 ) return(find_first_label(_items, _total, name));
+    _index = new Fl_Tree_Item_Index;
+    for ( int t=0; t<_total; t++ )
+      index_add(_items[t]);
+  }
+  unsigned h = Fl_Tree_Item_Index::hash_label(name);
+  Fl_Tree_Item *found = 0;
+  for ( int i = _index->first(h); i >= 0; i = _index->next(i) ) {
+    if ( _index->hash(i) != h || strcmp(_index->key(i)->label(), name) != 0 )
+      continue;
+    if ( found )		// several items have this label? use the first one
+      return(find_first_label(_items, _total, name));
+    found = _index->key(i);
+  }
+  return(found);
+}
+
+// Add 'item' to the hash table, if it has a label
+void Fl_Tree_Item_Array::index_add(Fl_Tree_Item *item) {
+  if ( item->label() ) _index->insert(item, Fl_Tree_Item_Index::hash_label(item->label()));
+}
+
+// Remove 'item' from the hash table. Returns 1 if it was in it.
+int Fl_Tree_Item_Array::index_remove(Fl_Tree_Item *item) {
+  if ( !_index || !item->label() ) return(0);
+  return(_index->remove(item, Fl_Tree_Item_Index::hash_label(item->label())));
+}
+#endif
+
 //
 // End of "$Id$".
 //
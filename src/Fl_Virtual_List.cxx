@@ -0,0 +1,330 @@
+//
+// "$Id$"
+//
+// Virtual list widget for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2016 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Virtual_List.H>
+#include <stdlib.h>
+#include <limits.h>
+
+// The widgets in pool_ are the children of the list, followed by the
+// scrollbar. bound_ holds the row each widget shows, or -1 for widgets
+// that are not used and hidden. The children are kept sorted by row,
+// so that Fl_Group::navigation() moves the focus to the next or the
+// previous row.
+
+// Returns the pixel position of row r. Lists taller than INT_MAX pixels
+// are cut off there, as positions are stored in an int.
+static int row_pixel(int r, int row_height) {
+  double p = (double)r * row_height;
+  return p > INT_MAX ? INT_MAX : (int)p;
+}
+
+void Fl_Virtual_List::scrollbar_cb(Fl_Widget* s, void*) {
+  ((Fl_Virtual_List*)(s->parent()))->position(int(((Fl_Scrollbar*)s)->value()));
+}
+
+/**
+  Creates a new Fl_Virtual_List widget using the given position, size,
+  and label string. The list has no rows until rows() is set, and the
+  default row height is 25 pixels.
+*/
+Fl_Virtual_List::Fl_Virtual_List(int X, int Y, int W, int H, const char *L)
+  : Fl_Group(X, Y, W, H, L),
+    scrollbar(0, 0, 0, 0) // resized by update_rows()
+{
+  box(FL_DOWN_BOX);
+  color(FL_BACKGROUND2_COLOR);
+  clip_children(1);
+  rows_ = 0;
+  row_height_ = 25;
+  overscan_ = 2;
+  position_ = 0;
+  scrollbar_size_ = 0;
+  pool_ = 0;
+  bound_ = 0;
+  npool_ = 0;
+  scrollbar.callback(scrollbar_cb);
+  end();
+  update_rows();
+}
+
+/**
+  The destructor deletes the list and the widgets of all rows.
+*/
+Fl_Virtual_List::~Fl_Virtual_List() {
+  free(pool_);
+  free(bound_);
+}
+
+// Returns the row that contains the focus widget, or -1.
+int Fl_Virtual_List::focus_row() const {
+  Fl_Widget *f = Fl::focus();
+  if (!f) return -1;
+  for (int k = 0; k < npool_; k++)
+    if (bound_[k] >= 0 && pool_[k]->contains(f)) return bound_[k];
+  return -1;
+}
+
+// Gives a widget to every row that is visible or in the overscan, and
+// moves the widgets and the scrollbar into place.
+void Fl_Virtual_List::update_rows() {
+  int X = x() + Fl::box_dx(box());
+  int Y = y() + Fl::box_dy(box());
+  int W = w() - Fl::box_dw(box());
+  int H = h() - Fl::box_dh(box());
+  int total = row_pixel(rows_, row_height_);
+  if (position_ > total - H) position_ = total - H;
+  if (position_ < 0) position_ = 0;
+
+  // the scrollbar is only needed if the rows don't fit:
+  int ss = scrollbar_size_ ? scrollbar_size_ : Fl::scrollbar_size();
+  int left = (scrollbar.align() & FL_ALIGN_LEFT) != 0;
+  if (total > H) {
+    scrollbar.resize(left ? X : X + W - ss, Y, ss, H);
+    scrollbar.value(position_, H, 0, total);
+    scrollbar.linesize(row_height_);
+    if (!scrollbar.visible()) scrollbar.set_visible();
+    if (left) X += ss;
+    W -= ss;
+  } else if (scrollbar.visible()) {
+    scrollbar.clear_visible();
+  }
+
+  int first = 0, last = -1;
+  if (rows_ > 0 && H > 0) {
+    first = position_ / row_height_ - overscan_;
+    last = (position_ + H - 1) / row_height_ + overscan_;
+    if (first < 0) first = 0;
+    if (last >= rows_) last = rows_ - 1;
+  }
+
+  // release the widgets of other rows, but keep the one with the focus:
+  int focus = focus_row();
+  if (focus >= rows_) focus = -1;
+  int i, k;
+  for (k = 0; k < npool_; k++) {
+    int r = bound_[k];
+    if (r >= 0 && (r < first || r > last) && r != focus) bound_[k] = -1;
+  }
+
+  // give a widget to the rows that have none:
+  for (i = first; i <= last; i++) {
+    for (k = 0; k < npool_ && bound_[k] != i; k++) {}
+    if (k < npool_) continue;
+    for (k = 0; k < npool_ && bound_[k] >= 0; k++) {}
+    if (k == npool_) {
+      Fl_Group *saved = Fl_Group::current();
+      Fl_Group::current(0);
+      Fl_Widget *o = create_row();
+      Fl_Group::current(saved);
+      if (!o) return;
+      if (!(npool_ & (npool_ - 1))) {
+        int size = npool_ ? 2 * npool_ : 16;
+        pool_ = (Fl_Widget**)realloc((void*)pool_, size * sizeof(Fl_Widget*));
+        bound_ = (int*)realloc((void*)bound_, size * sizeof(int));
+      }
+      add(o);
+      pool_[npool_++] = o;
+    }
+    bound_[k] = i;
+    bind_row(pool_[k], i);
+  }
+
+  // move the widgets to their rows, the row with the focus goes below
+  // the list if it is not visible:
+  for (k = 0; k < npool_; k++) {
+    Fl_Widget *o = pool_[k];
+    int r = bound_[k];
+    if (r < 0) {
+      if (o->visible()) o->hide();
+      continue;
+    }
+    int yy = (r < first || r > last) ? y() + h()
+           : Y + (r - position_ / row_height_) * row_height_ - position_ % row_height_;
+    if (o->x() != X || o->y() != yy || o->w() != W || o->h() != row_height_)
+      o->resize(X, yy, W, row_height_);
+    if (!o->visible()) o->show();
+  }
+
+  // sort the widgets by row, unused ones last:
+  for (k = 1; k < npool_; k++) {
+    Fl_Widget *o = pool_[k];
+    int r = bound_[k] < 0 ? rows_ : bound_[k];
+    for (i = k; i > 0 && (bound_[i-1] < 0 ? rows_ : bound_[i-1]) > r; i--) {
+      pool_[i] = pool_[i-1];
+      bound_[i] = bound_[i-1];
+    }
+    pool_[i] = o;
+    bound_[i] = r < rows_ ? r : -1;
+  }
+  if (children() == npool_ + 1) {	// the scrollbar ends up last
+    for (k = 0; k < npool_; k++)
+      if (child(k) != pool_[k]) insert(*pool_[k], k);
+  }
+}
+
+int Fl_Virtual_List::handle(int event) {
+  if (event == FL_KEYBOARD) {
+    int r = focus_row();
+    if (r >= 0) {
+      display(r);
+      if (!Fl_Group::handle(event)) {
+        // the next row may not have a widget yet, scroll to it and try again:
+        if (Fl::event_state(FL_CTRL | FL_ALT | FL_META)) return 0;
+        int key = Fl::event_key(), next = r;
+        if (key == FL_Down || (key == FL_Tab && !Fl::event_state(FL_SHIFT))) next = r + 1;
+        else if (key == FL_Up || (key == FL_Tab && Fl::event_state(FL_SHIFT))) next = r - 1;
+        if (next == r || next < 0 || next >= rows_) return 0;
+        display(next);
+        if (!Fl_Group::handle(event)) return 0;
+      }
+      r = focus_row();
+      if (r >= 0) display(r);
+      return 1;
+    }
+  }
+  return Fl_Group::handle(event);
+}
+
+/**
+  Resizes the list and moves the row widgets to fit. The row widgets are
+  resized to the new width of the list.
+*/
+void Fl_Virtual_List::resize(int X, int Y, int W, int H) {
+  Fl_Widget::resize(X, Y, W, H);
+  update_rows();
+  redraw();
+}
+
+/**
+  Sets the number of rows in the list.
+
+  The rows that keep their widget are not bound again, call rebind() if
+  their data changed too.
+
+  Scrolling positions are stored in an int, so only the rows in the
+  first INT_MAX pixels of the list can be shown, e.g. the first 85
+  million rows with the default row height.
+*/
+void Fl_Virtual_List::rows(int n) {
+  if (n < 0) n = 0;
+  if (n == rows_) return;
+  rows_ = n;
+  update_rows();
+  redraw();
+}
+
+/**
+  Sets the height of all rows in pixels. The top row stays the same.
+*/
+void Fl_Virtual_List::row_height(int h) {
+  if (h < 1) h = 1;
+  if (h == row_height_) return;
+  int top = top_row();
+  row_height_ = h;
+  position_ = row_pixel(top, h);
+  update_rows();
+  redraw();
+}
+
+/**
+  Sets the number of rows above and below the visible ones that have a
+  widget. A few extra rows make keyboard navigation and scrolling by
+  small amounts cheaper, because their widgets are bound already.
+*/
+void Fl_Virtual_List::overscan(int n) {
+  if (n < 0) n = 0;
+  if (n == overscan_) return;
+  overscan_ = n;
+  update_rows();
+}
+
+/**
+  Scrolls the list to the pixel position \p pos, i.e. \p pos pixels of
+  the list are scrolled off the top edge.
+*/
+void Fl_Virtual_List::position(int pos) {
+  if (pos == position_) return;
+  position_ = pos;
+  update_rows();
+  redraw();
+}
+
+/**
+  Scrolls the list so that row \p index is the top row.
+*/
+void Fl_Virtual_List::top_row(int index) {
+  position(row_pixel(index, row_height_));
+}
+
+/**
+  Returns the row at the top of the list. It may be partially scrolled
+  off the top edge.
+*/
+int Fl_Virtual_List::top_row() const {
+  return position_ / row_height_;
+}
+
+/**
+  Scrolls the list as little as possible to make row \p index visible.
+*/
+void Fl_Virtual_List::display(int index) {
+  if (index < 0 || index >= rows_) return;
+  int H = h() - Fl::box_dh(box());
+  int top = row_pixel(index, row_height_);
+  if (top < position_) position(top);
+  else {
+    double bottom = (double)top + row_height_ - H; // may not fit in an int
+    if (bottom > position_) position(bottom > INT_MAX ? INT_MAX : (int)bottom);
+  }
+}
+
+/**
+  Returns the widget that shows row \p index, or NULL if the row has no
+  widget because it is not visible. The widget is only valid until the
+  list is scrolled or changed.
+*/
+Fl_Widget *Fl_Virtual_List::row_widget(int index) const {
+  for (int k = 0; k < npool_; k++) if (bound_[k] == index) return pool_[k];
+  return 0;
+}
+
+/**
+  Returns the row shown by the row widget that is or contains \p w, or
+  -1 if \p w is not part of a row. This is useful in the callbacks of
+  the widgets of a row.
+*/
+int Fl_Virtual_List::row_index(const Fl_Widget *w) const {
+  if (!w) return -1;
+  for (int k = 0; k < npool_; k++)
+    if (bound_[k] >= 0 && pool_[k]->contains(w)) return bound_[k];
+  return -1;
+}
+
+/**
+  Binds all row widgets again, after the data of the rows changed.
+*/
+void Fl_Virtual_List::rebind() {
+  for (int k = 0; k < npool_; k++)
+    if (bound_[k] >= 0) bind_row(pool_[k], bound_[k]);
+  redraw();
+}
+
+//
+// End of "$Id$".
+//
@@ -20,6 +20,7 @@
 #include <FL/Fl_Widget.H>
 #include <FL/Fl_Group.H>
 #include <FL/Fl_Tooltip.H>
+#include <FL/Fl_Widget_Arena.H>
 #include <FL/fl_draw.H>
 #include <stdlib.h>
 #include "flstring.h"
@@ -133,6 +134,13 @@ Fl_Widget::Fl_Widget(int X, int Y, int W, int H, const char* L) {
   user_data_ 	 = 0;
   type_		 = 0;
   flags_	 = VISIBLE_FOCUS;
+  // created with new (arena)? Derived classes may put Fl_Widget at an offset:
+  if ((char*)this >= Fl_Widget_Arena::last_ &&
+      (char*)this < Fl_Widget_Arena::last_ + Fl_Widget_Arena::last_size_) {
+    flags_ |= IN_ARENA;
+    Fl_Widget_Arena::last_arena_->live_++;
+    Fl_Widget_Arena::last_ = 0;
+  }
   damage_	 = 0;
   box_		 = FL_NO_BOX;
   color_	 = FL_GRAY;
@@ -140,6 +148,9 @@ Fl_Widget::Fl_Widget(int X, int Y, int W, int H, const char* L) {
   when_		 = FL_WHEN_RELEASE;
 
   parent_ = 0;
+#if FLTK_ABI_VERSION >= 10304
+  child_index_ = 0;
+#endif
   if (Fl_Group::current()) Fl_Group::current()->add(this);
   if (!fl_graphics_driver) {
     // Make sure fl_graphics_driver is initialized. Important if we are called by a static initializer.
@@ -148,7 +159,14 @@ Fl_Widget::Fl_Widget(int X, int Y, int W, int H, const char* L) {
 }
 
 void Fl_Widget::resize(int X, int Y, int W, int H) {
+  // the parent must place its children before this one moves:
+  if (parent_ && (parent_->flags() & LAYOUT_PENDING)) parent_->layout();
   x_ = X; y_ = Y; w_ = W; h_ = H;
+#if FLTK_ABI_VERSION >= 10304
+  // Fl_Value_Input makes itself the parent of its input, which is no group:
+  Fl_Group *g = parent_ ? parent_->as_group() : 0;
+  if (g) g->child_changed(this, Fl_Group::CHILD_RESIZED);
+#endif
 }
 
 // this is useful for parent widgets to call to resize children:
@@ -317,6 +335,26 @@ Fl_Widget::label(const char *a) {
   }
   label_.value=a;
   redraw_label();
+  shortcuts_changed();
+  label_changed();
+}
+
+/**
+  Tells the parent group that the label, its alignment, size or image
+  changed.
+
+  The setters of these attributes call this already. A group with a
+  spatial index, or an Fl_Scroll with lazy scrolling, must know which
+  children draw their label outside of their box.
+
+  \see Fl_Group::spatial_index(int), Fl_Scroll::lazy_scroll(int)
+*/
+void Fl_Widget::label_changed() {
+#if FLTK_ABI_VERSION >= 10304
+  // Fl_Value_Input makes itself the parent of its input, which is no group:
+  Fl_Group *g = parent_ ? parent_->as_group() : 0;
+  if (g) g->child_changed(this, Fl_Group::CHILD_LABEL);
+#endif
 }
 
 
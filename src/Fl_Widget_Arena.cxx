@@ -0,0 +1,218 @@
+//
+// "$Id$"
+//
+// Widget arena for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2016 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Widget_Arena.H>
+#include <stdlib.h>
+
+// Fl_Widget::operator delete() must find out if a widget is in an arena.
+// The chunks of all arenas are kept sorted by address for that:
+struct Fl_Arena_Chunk {
+  const char *begin, *end;
+  Fl_Widget_Arena *arena;
+};
+
+static Fl_Arena_Chunk *all_chunks = 0;
+static int num_chunks = 0, max_chunks = 0;
+static Fl_Widget_Arena *owned_arenas = 0;
+
+char *Fl_Widget_Arena::last_ = 0;
+size_t Fl_Widget_Arena::last_size_ = 0;
+Fl_Widget_Arena *Fl_Widget_Arena::last_arena_ = 0;
+
+// Returns the first chunk that ends after p:
+static int find_chunk(const void *p) {
+  int lo = 0, hi = num_chunks;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (all_chunks[mid].end <= (const char*)p) lo = mid + 1; else hi = mid;
+  }
+  return lo;
+}
+
+/**
+  Creates an empty arena. The memory is allocated in chunks of
+  \p chunk_size bytes when it is needed.
+*/
+Fl_Widget_Arena::Fl_Widget_Arena(size_t chunk_size) {
+  chunks_ = 0;
+  nchunks_ = 0;
+  next_ = 0;
+  left_ = 0;
+  chunk_size_ = chunk_size < 1024 ? 1024 : chunk_size;
+  used_ = 0;
+  live_ = 0;
+  orphan_ = 0;
+  owner_ = 0;
+  next_arena_ = 0;
+}
+
+/**
+  Frees all memory of the arena. The widgets allocated from it must be
+  deleted already. An arena that was given to a group is deleted by the
+  group, do not delete it yourself.
+*/
+Fl_Widget_Arena::~Fl_Widget_Arena() {
+  int i, j = 0;
+  for (i = 0; i < num_chunks; i++)
+    if (all_chunks[i].arena != this) all_chunks[j++] = all_chunks[i];
+  num_chunks = j;
+  for (i = 0; i < nchunks_; i++) free(chunks_[i]);
+  free(chunks_);
+  if (owner_) {
+    Fl_Widget_Arena **a = &owned_arenas;
+    while (*a != this) a = &(*a)->next_arena_;
+    *a = next_arena_;
+  }
+  if (last_arena_ == this) last_ = 0, last_arena_ = 0;
+}
+
+// Called by the destructor of the owner, after it deleted its children:
+void Fl_Widget_Arena::owner_deleted() {
+  Fl_Widget_Arena **a = &owned_arenas;
+  while (*a != this) a = &(*a)->next_arena_;
+  *a = next_arena_;
+  owner_ = 0;
+  if (live_) orphan_ = 1;	// some widgets were moved to another group
+  else delete this;
+}
+
+/**
+  Returns \p size bytes of memory that stay valid until the arena is
+  deleted. The memory is aligned for any type.
+*/
+void *Fl_Widget_Arena::allocate(size_t size) {
+  const size_t align = 2 * sizeof(double);
+  size = (size + align - 1) & ~(align - 1);
+  if (size > left_) {
+    // big objects get a chunk of their own, the rest of the last one is kept:
+    size_t n = size > chunk_size_ / 4 ? size : chunk_size_;
+    char *c = (char*)malloc(n);
+    if (!c) Fl::fatal("Fl_Widget_Arena: out of memory");
+    if (!(nchunks_ & (nchunks_ - 1))) {
+      int a = nchunks_ ? 2 * nchunks_ : 4;
+      chunks_ = (char**)realloc((void*)chunks_, a * sizeof(char*));
+    }
+    chunks_[nchunks_++] = c;
+    if (num_chunks >= max_chunks) {
+      max_chunks = max_chunks ? 2 * max_chunks : 16;
+      all_chunks = (Fl_Arena_Chunk*)realloc((void*)all_chunks, max_chunks * sizeof(Fl_Arena_Chunk));
+    }
+    int k = find_chunk(c);
+    for (int i = num_chunks; i > k; i--) all_chunks[i] = all_chunks[i-1];
+    all_chunks[k].begin = c;
+    all_chunks[k].end = c + n;
+    all_chunks[k].arena = this;
+    num_chunks++;
+    used_ += size;
+    if (n == size) return c;
+    next_ = c;
+    left_ = n;
+  }
+  void *p = next_;
+  next_ += size;
+  left_ -= size;
+  used_ += size;
+  return p;
+}
+
+/**
+  Returns \p size bytes of memory for a widget. This is called by
+  <tt>new (arena) Widget(...)</tt>, the widget constructor then marks
+  the widget as part of the arena.
+*/
+void *Fl_Widget_Arena::allocate_widget(size_t size) {
+  last_ = (char*)allocate(size);
+  last_size_ = size;
+  last_arena_ = this;
+  return last_;
+}
+
+/**
+  Deletes a widget, whether it was created in an arena or with \c new.
+
+  Use this instead of \c delete for widgets created in an arena. The
+  memory stays in the arena until the arena is deleted.
+*/
+void Fl_Widget_Arena::destroy(Fl_Widget *w) {
+  if (!w) return;
+  Fl_Widget_Arena *a = (w->flags() & Fl_Widget::IN_ARENA) ? owner_of(w) : 0;
+  if (!a) {
+    delete w;
+    return;
+  }
+  w->~Fl_Widget();
+  if (!--a->live_ && a->orphan_) delete a;
+}
+
+/**
+  Returns non-zero if \p p points into the memory of this arena.
+*/
+int Fl_Widget_Arena::contains(const void *p) const {
+  return owner_of(p) == this;
+}
+
+// Returns the arena owned by group g:
+Fl_Widget_Arena *Fl_Widget_Arena::find(const Fl_Group *g) {
+  Fl_Widget_Arena *a = owned_arenas;
+  while (a && a->owner_ != g) a = a->next_arena_;
+  return a;
+}
+
+// Returns the arena that p points into, or NULL:
+Fl_Widget_Arena *Fl_Widget_Arena::owner_of(const void *p) {
+  if (!num_chunks) return 0;
+  int k = find_chunk(p);
+  if (k < num_chunks && all_chunks[k].begin <= (const char*)p) return all_chunks[k].arena;
+  return 0;
+}
+
+/**
+  Gives an Fl_Widget_Arena to the group.
+
+  The widgets are allocated from the arena with <tt>new (arena)</tt>,
+  they can be children of this group or of any other group. The group
+  deletes the arena in its destructor, after it deleted its children.
+  If widgets of the arena are still alive then, e.g. because they were
+  moved to another group, the arena is deleted with the last of them.
+
+  The arena of a group can not be changed, this method does nothing if
+  the group has an arena already, or if the arena has an owner.
+
+  \see Fl_Widget_Arena
+*/
+void Fl_Group::arena(Fl_Widget_Arena *a) {
+  if (!a || (flags() & ARENA_OWNER) || a->owner_ || a->orphan_) return;
+  a->owner_ = this;
+  a->next_arena_ = owned_arenas;
+  owned_arenas = a;
+  set_flag(ARENA_OWNER);
+}
+
+/**
+  Returns the arena of the group, or NULL.
+  \see arena(Fl_Widget_Arena*)
+*/
+Fl_Widget_Arena *Fl_Group::arena() const {
+  return (flags() & ARENA_OWNER) ? Fl_Widget_Arena::find(this) : 0;
+}
+
+//
+// End of "$Id$".
+//
@@ -53,6 +53,9 @@ void Fl_Window::_Fl_Window() {
   size_range_set = 0;
   minw = maxw = minh = maxh = 0;
   shape_data_ = NULL;
+#if FLTK_ABI_VERSION >= 10304
+  shortcut_index_ = 0;
+#endif
 
 #if FLTK_ABI_VERSION >= 10301
   no_fullscreen_x = 0;
@@ -104,6 +107,9 @@ Fl_Window::~Fl_Window() {
 #endif
     delete shape_data_;
   }
+#if FLTK_ABI_VERSION >= 10304
+  shortcut_index(0);
+#endif
 }
 
 
@@ -20,24 +20,47 @@
 // Replaces the older set_idle() call (which is used to implement this)
 
 #include <FL/Fl.H>
+#include "fl_loop_stats.h"
 
 struct idle_cb {
   void (*cb)(void*);
   void* data;
+  int priority;
+  double slice;
   idle_cb *next;
 };
 
-// the callbacks are stored linked in a ring.  last points at the one
-// just called, first at the next to call.  last->next == first.
+// The callbacks are kept in a list sorted by decreasing priority, callbacks
+// of equal priority in the order they were added.  Each call of call_idle()
+// continues a round through the list at next; when the round is over the
+// next one starts again at first.  Without an idle budget only one callback
+// is called, which makes this the old round-robin behavior.
 
 static idle_cb* first;
-static idle_cb* last;
+static idle_cb* next;
 static idle_cb* freelist;
+static double budget;		// time to spend in idle callbacks per Fl::wait()
+static double deadline;		// end of the running callback's time slice
 
 static void call_idle() {
-  idle_cb* p = first;
-  last = p; first = p->next;
-  p->cb(p->data); // this may call add_idle() or remove_idle()!
+  double end = budget > 0.0 ? fl_loop_stat_time() + budget : 0.0;
+  for (;;) {
+    if (!next) next = first;
+    idle_cb* p = next;
+    if (!p) return;
+    next = p->next;
+    Fl_Idle_Handler cb = p->cb;
+    double now = 0.0;
+    if (end > 0.0 || p->slice > 0.0) now = fl_loop_stat_time();
+    deadline = end;
+    if (p->slice > 0.0 && (end == 0.0 || now + p->slice < end)) deadline = now + p->slice;
+    double t0 = fl_loop_stat_start();
+    cb(p->data); // this may call add_idle() or remove_idle()!
+    fl_loop_stat_end(FL_LOOP_IDLE, (const void*)cb, t0);
+    deadline = 0.0;
+    // stop when the budget is used up, or a timeout or an event is due:
+    if (end == 0.0 || fl_loop_stat_time() >= end || Fl::ready()) return;
+  }
 }
 
 /**
@@ -56,57 +79,122 @@ static void call_idle() {
   Fl::check(), and Fl::ready().
 
   FLTK will not recursively call the idle callback.
+
+  \see Fl::add_idle(Fl_Idle_Handler, void*, int, double), Fl::idle_budget(double)
 */
 void Fl::add_idle(Fl_Idle_Handler cb, void* data) {
+  add_idle(cb, data, 0, 0.0);
+}
+
+/**
+  Adds an idle callback with a priority and a time slice.
+
+  Every Fl::wait() calls the idle callbacks in a round, starting with the
+  highest \p priority; callbacks of equal priority are called in the order
+  they were added. By default only one callback is called per Fl::wait(),
+  and the next one is called by the following Fl::wait(). If an idle
+  budget is set with Fl::idle_budget(double), Fl::wait() continues the round
+  until the budget is used up, a timeout expired, or an event is pending.
+
+  Idle callbacks are cooperative: they should do a small amount of work and
+  return. The \p slice is the time the callback may take per call, the
+  callback can find out how much of it is left with Fl::idle_time_left():
+
+  \code
+  void background_work(void *data) {
+    do {
+      if (!do_one_chunk(data)) { Fl::remove_idle(background_work, data); break; }
+    } while (Fl::idle_time_left() > 0.0);
+  }
+  ...
+  Fl::idle_budget(0.010);                               // 10 ms per Fl::wait()
+  Fl::add_idle(background_work, job, 10, 0.002);       // 2 ms slices
+  \endcode
+
+  Time spent in idle callbacks is measured by Fl::collect_loop_stats().
+
+  \param[in] cb the callback
+  \param[in] data user data passed to the callback
+  \param[in] priority callbacks with higher priority are called first
+  \param[in] slice time in seconds the callback should take, 0 for no limit
+    other than the idle budget
+*/
+void Fl::add_idle(Fl_Idle_Handler cb, void* data, int priority, double slice) {
   idle_cb* p = freelist;
   if (p) freelist = p->next;
   else p = new idle_cb;
   p->cb = cb;
   p->data = data;
-  if (first) {
-    last->next = p;
-    last = p;
-    p->next = first;
-  } else {
-    first = last = p;
-    p->next = p;
-    set_idle(call_idle);
-  }
+  p->priority = priority;
+  p->slice = slice;
+  if (!first) set_idle(call_idle);
+  idle_cb** q = &first;
+  while (*q && (*q)->priority >= priority) q = &((*q)->next);
+  p->next = *q;
+  *q = p;
 }
 
 /**
   Returns true if the specified idle callback is currently installed.
 */
 int Fl::has_idle(Fl_Idle_Handler cb, void* data) {
-  idle_cb* p = first;
-  if (!p) return 0;
-  for (;; p = p->next) {
+  for (idle_cb* p = first; p; p = p->next)
     if (p->cb == cb && p->data == data) return 1;
-    if (p==last) return 0;
-  }
+  return 0;
 }
 
 /**
   Removes the specified idle callback, if it is installed.
 */
 void Fl::remove_idle(Fl_Idle_Handler cb, void* data) {
-  idle_cb* p = first;
-  if (!p) return;
-  idle_cb* l = last;
-  for (;; p = p->next) {
-    if (p->cb == cb && p->data == data) break;
-    if (p==last) return; // not found
-    l = p;
-  }
-  if (l == p) { // only one
-    first = last = 0;
-    set_idle(0);
-  } else {
-    last = l;
-    first = l->next = p->next;
+  for (idle_cb** q = &first; *q; q = &((*q)->next)) {
+    idle_cb* p = *q;
+    if (p->cb == cb && p->data == data) {
+      if (next == p) next = p->next;
+      *q = p->next;
+      p->next = freelist;
+      freelist = p;
+      if (!first) set_idle(0);
+      return;
+    }
   }
-  p->next = freelist;
-  freelist = p;
+}
+
+/**
+  Sets the time Fl::wait() may spend calling idle callbacks.
+
+  With the default budget of 0, Fl::wait() calls one idle callback and
+  then checks for events and timeouts. With a budget, it keeps calling
+  idle callbacks in priority order until the budget is used up, a timeout
+  expired, or an event is pending.
+
+  \param[in] seconds time per Fl::wait(), or 0 to call one callback
+  \see Fl::add_idle(Fl_Idle_Handler, void*, int, double)
+*/
+void Fl::idle_budget(double seconds) {
+  budget = seconds > 0.0 ? seconds : 0.0;
+}
+
+/**
+  Returns the time Fl::wait() may spend calling idle callbacks.
+  \see Fl::idle_budget(double)
+*/
+double Fl::idle_budget() {
+  return budget;
+}
+
+/**
+  Returns the time left in the time slice of the running idle callback.
+
+  This is the time until the end of the callback's slice or of the idle
+  budget, whichever comes first. It returns 0 if the time is used up,
+  if neither a slice nor a budget is set, or if it is not called from
+  an idle callback.
+*/
+double Fl::idle_time_left() {
+  if (deadline == 0.0) return 0.0;
+  double left = deadline - fl_loop_stat_time();
+  return left > 0.0 ? left : 0.0;
 }
 
 //
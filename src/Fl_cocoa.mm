@@ -3267,7 +3267,7 @@ void Fl_Window::resize(int X,int Y,int W,int H) {
         redraw();
       }
     } else {
-      x(X); y(Y);
+      Fl_Widget::resize(X, Y, w(), h()); // tell the parent about the move
     }
   }
 }
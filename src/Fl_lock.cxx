@@ -21,6 +21,7 @@
 #include <config.h>
 
 #include <stdlib.h>
+#include "fl_loop_stats.h"
 
 /*
    From Bill:
@@ -324,7 +325,9 @@ static void thread_awake_cb(int fd, void*) {
   Fl_Awake_Handler func;
   void *data;
   while (Fl::get_awake_handler_(func, data)==0) {
+    double t0 = fl_loop_stat_start();
     (*func)(data);
+    fl_loop_stat_end(FL_LOOP_AWAKE, (const void*)func, t0);
   }
 }
 
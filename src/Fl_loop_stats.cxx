@@ -0,0 +1,218 @@
+//
+// "$Id$"
+//
+// Event loop statistics for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2016 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Records how long each callback dispatched by Fl::wait() and each
+// window flush takes. The records are kept in an array in the order
+// they were created, and found by an open addressing hash table that
+// stores array indices.
+
+#if defined(WIN32) && !defined(__CYGWIN__)
+#  include <windows.h>
+#else
+#  include <sys/time.h>
+#endif
+
+#include <FL/Fl.H>
+#include "fl_loop_stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char read_environment();
+
+char fl_loop_stats_on = read_environment();
+
+static Fl_Loop_Stat *stats;	// the records
+static int nstats, stats_size;
+static int *hash;		// indices into stats, -1 = empty
+static int hash_size;		// a power of 2
+
+double fl_loop_stat_time() {
+#if defined(WIN32) && !defined(__CYGWIN__)
+  static double freq;
+  LARGE_INTEGER t;
+  if (!freq) {
+    QueryPerformanceFrequency(&t);
+    freq = (double)t.QuadPart;
+  }
+  QueryPerformanceCounter(&t);
+  return t.QuadPart / freq;
+#else
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+#endif
+}
+
+static unsigned hash_key(int kind, const void *key) {
+  size_t k = (size_t)key;
+  k ^= k >> 17;
+  return (unsigned)(k * 2654435761UL) ^ (unsigned)kind;
+}
+
+static void rehash(int size) {
+  free(hash);
+  hash_size = size;
+  hash = (int*)malloc(hash_size * sizeof(int));
+  for (int i = 0; i < hash_size; i++) hash[i] = -1;
+  for (int n = 0; n < nstats; n++) {
+    unsigned h = hash_key(stats[n].kind, stats[n].key) & (hash_size - 1);
+    while (hash[h] >= 0) h = (h + 1) & (hash_size - 1);
+    hash[h] = n;
+  }
+}
+
+static Fl_Loop_Stat *find_stat(int kind, const void *key) {
+  if (2 * (nstats + 1) > hash_size) rehash(hash_size ? 2 * hash_size : 64);
+  unsigned h = hash_key(kind, key) & (hash_size - 1);
+  for (; hash[h] >= 0; h = (h + 1) & (hash_size - 1)) {
+    Fl_Loop_Stat *s = stats + hash[h];
+    if (s->key == key && s->kind == kind) return s;
+  }
+  if (nstats >= stats_size) {
+    stats_size = stats_size ? 2 * stats_size : 32;
+    stats = (Fl_Loop_Stat*)realloc(stats, stats_size * sizeof(Fl_Loop_Stat));
+  }
+  hash[h] = nstats;
+  Fl_Loop_Stat *s = stats + nstats++;
+  memset(s, 0, sizeof(*s));
+  s->kind = kind;
+  s->key = key;
+  return s;
+}
+
+void fl_loop_stat_count(unsigned long &count, double &total, double &max,
+                        unsigned long *histogram, double t) {
+  if (t < 0.0) t = 0.0;
+  count++;
+  total += t;
+  if (t > max) max = t;
+  int b = 0;
+  for (double us = t * 1000000.0; us >= 1.0 && b < FL_LOOP_STAT_BUCKETS - 1; us /= 2) b++;
+  histogram[b]++;
+}
+
+void fl_loop_stat_print_histogram(FILE *f, const unsigned long *histogram) {
+  for (int b = 0; b < FL_LOOP_STAT_BUCKETS; b++) {
+    if (!histogram[b]) continue;
+    if (b == FL_LOOP_STAT_BUCKETS - 1) fprintf(f, " >=%lu:%lu", 1UL << (b - 1), histogram[b]);
+    else fprintf(f, " <%lu:%lu", 1UL << b, histogram[b]);
+  }
+}
+
+void fl_loop_stat_add(int kind, const void *key, double start) {
+  Fl_Loop_Stat *s = find_stat(kind, key);
+  fl_loop_stat_count(s->count, s->total, s->max, s->histogram, fl_loop_stat_time() - start);
+}
+
+/**
+  Turns collection of event loop statistics on or off.
+
+  While switched on, Fl::wait() measures the time spent in every timeout,
+  check, idle, file descriptor and Fl::awake() callback, and in the flush
+  of every window. The results are available with Fl::loop_stats().
+  Switching collection off keeps the results collected so far.
+
+  Collection is switched on at startup if the environment variable
+  \c FLTK_LOOP_STATS is set. A report is then written when the program
+  exits, to stderr if the variable is "1" or empty, to the named file
+  otherwise.
+
+  \note Timeouts are only measured on X11 so far.
+
+  \see Fl::loop_stats(int&), Fl::print_loop_stats()
+*/
+void Fl::collect_loop_stats(int on) {
+  fl_loop_stats_on = on ? 1 : 0;
+}
+
+/**
+  Returns non-zero if event loop statistics are being collected.
+*/
+int Fl::collect_loop_stats() {
+  return fl_loop_stats_on;
+}
+
+/**
+  Returns the event loop statistics collected so far.
+
+  There is one record for every callback function and every window
+  that has been measured, see Fl_Loop_Stat. The returned array is
+  owned by FLTK and is invalidated by the next measurement or by
+  Fl::clear_loop_stats().
+
+  \param[out] count number of records in the array
+*/
+const Fl_Loop_Stat *Fl::loop_stats(int &count) {
+  count = nstats;
+  return stats;
+}
+
+/**
+  Discards all event loop statistics collected so far.
+*/
+void Fl::clear_loop_stats() {
+  nstats = 0;
+  if (hash) rehash(hash_size);
+}
+
+static const char *kind_names[] = {
+  "timeout", "check", "idle", "fd", "awake", "flush"
+};
+
+/**
+  Writes a report of the event loop statistics.
+
+  The report lists each measured callback and window with its call
+  count, total, mean and maximum time, and the non-empty buckets of
+  its duration histogram.
+
+  \param[in] filename file to write, or NULL to write to stderr
+*/
+void Fl::print_loop_stats(const char *filename) {
+  FILE *f = filename ? fl_fopen(filename, "w") : stderr;
+  if (!f) return;
+  fprintf(f, "FLTK event loop statistics (times in microseconds):\n");
+  fprintf(f, "%-8s %-18s %10s %12s %10s %10s  histogram\n",
+          "kind", "key", "count", "total", "mean", "max");
+  for (int n = 0; n < nstats; n++) {
+    const Fl_Loop_Stat *s = stats + n;
+    const char *kind = (s->kind >= 0 && s->kind <= FL_LOOP_FLUSH) ? kind_names[s->kind] : "?";
+    fprintf(f, "%-8s %-18p %10lu %12.0f %10.1f %10.0f ", kind, s->key, s->count,
+            s->total * 1000000.0, s->count ? s->total * 1000000.0 / s->count : 0.0,
+            s->max * 1000000.0);
+    fl_loop_stat_print_histogram(f, s->histogram);
+    fprintf(f, "\n");
+  }
+  if (f != stderr) fclose(f);
+}
+
+static void print_at_exit() {
+  const char *name = fl_getenv("FLTK_LOOP_STATS");
+  Fl::print_loop_stats((name && *name && strcmp(name, "1")) ? name : 0);
+}
+
+static char read_environment() {
+  if (!fl_getenv("FLTK_LOOP_STATS")) return 0;
+  atexit(print_at_exit);
+  return 1;
+}
+
+//
+// End of "$Id$".
+//
@@ -31,6 +31,7 @@
 #include <FL/Fl_Tooltip.H>
 #include <FL/Fl_Paged_Device.H>
 #include "flstring.h"
+#include "fl_loop_stats.h"
 #include "Fl_Font.H"
 #include <stdio.h>
 #include <stdlib.h>
@@ -352,7 +353,9 @@ static void process_awake_handler_requests(void) {
   Fl_Awake_Handler func;
   void *data;
   while (Fl::get_awake_handler_(func, data) == 0) {
+    double t0 = fl_loop_stat_start();
     func(data);
+    fl_loop_stat_end(FL_LOOP_AWAKE, (const void*)func, t0);
   }
 }
 
@@ -1645,7 +1648,7 @@ void Fl_Window::resize(int X,int Y,int W,int H) {
         i->wait_for_expose = 1;
     }
   } else {
-    x(X); y(Y);
+    Fl_Widget::resize(X, Y, w(), h()); // tell the parent about the move
     flags |= SWP_NOSIZE;
   }
   if (!border()) flags |= SWP_NOACTIVATE;
@@ -32,6 +32,7 @@
 #  include <FL/Fl_Window.H>
 #  include <FL/fl_utf8.h>
 #  include <FL/Fl_Tooltip.H>
+#  include <FL/Fl_Headless.H>
 #  include <FL/fl_draw.H>
 #  include <FL/Fl_Paged_Device.H>
 #  include <FL/Fl_Shared_Image.H>
@@ -40,6 +41,7 @@
 #  include <stdio.h>
 #  include <stdlib.h>
 #  include "flstring.h"
+#  include "fl_loop_stats.h"
 #  include <unistd.h>
 #  include <time.h>
 #  include <sys/time.h>
@@ -199,12 +201,46 @@ extern int fl_send_system_handlers(void *e);
 static Fl_Window* send_motion;
 extern Fl_Window* fl_xmousewin;
 #endif
+extern char fl_compress_events;		// in Fl.cxx
+extern unsigned long fl_compressed_motion;
+extern unsigned long fl_compressed_expose;
+
+// Merge a sequence of queued expose events into xevent. Pointer motion
+// needs no look-ahead here: CONSOLIDATE_MOTION already sends only the
+// last motion of each batch of queued events as FL_MOVE or FL_DRAG.
+static void compress_event(XEvent &xevent) {
+  XEvent next;
+  switch (xevent.type) {
+  case Expose:
+  case GraphicsExpose: {
+    // the count field tells how many more rectangles of this exposure follow:
+    int x1 = xevent.xexpose.x, y1 = xevent.xexpose.y;
+    int x2 = x1 + xevent.xexpose.width, y2 = y1 + xevent.xexpose.height;
+    while (xevent.xexpose.count > 0 && XQLength(fl_display)) {
+      XPeekEvent(fl_display, &next);
+      if (next.type != xevent.type || next.xexpose.window != xevent.xexpose.window) break;
+      XNextEvent(fl_display, &xevent);
+      if (xevent.xexpose.x < x1) x1 = xevent.xexpose.x;
+      if (xevent.xexpose.y < y1) y1 = xevent.xexpose.y;
+      if (xevent.xexpose.x + xevent.xexpose.width > x2) x2 = xevent.xexpose.x + xevent.xexpose.width;
+      if (xevent.xexpose.y + xevent.xexpose.height > y2) y2 = xevent.xexpose.y + xevent.xexpose.height;
+      fl_compressed_expose++;
+    }
+    xevent.xexpose.x = x1;
+    xevent.xexpose.y = y1;
+    xevent.xexpose.width = x2 - x1;
+    xevent.xexpose.height = y2 - y1;
+    break; }
+  }
+}
+
 static bool in_a_window; // true if in any of our windows, even destroyed ones
 static void do_queued_events() {
   in_a_window = true;
   while (XEventsQueued(fl_display,QueuedAfterReading)) {
     XEvent xevent;
     XNextEvent(fl_display, &xevent);
+    if (fl_compress_events) compress_event(xevent);
     if (fl_send_system_handlers(&xevent))
       continue;
     fl_handle(xevent);
@@ -266,15 +302,20 @@ int fl_wait(double time_to_wait) {
   if (n > 0) {
     for (int i=0; i<nfds; i++) {
 #  if USE_POLL
-      if (pollfds[i].revents) fd[i].cb(pollfds[i].fd, fd[i].arg);
+      if (!pollfds[i].revents) continue;
+      int f = pollfds[i].fd;
 #  else
       int f = fd[i].fd;
       short revents = 0;
       if (FD_ISSET(f,&fdt[0])) revents |= POLLIN;
       if (FD_ISSET(f,&fdt[1])) revents |= POLLOUT;
       if (FD_ISSET(f,&fdt[2])) revents |= POLLERR;
-      if (fd[i].events & revents) fd[i].cb(f, fd[i].arg);
+      if (!(fd[i].events & revents)) continue;
 #  endif
+      void (*cb)(int, void*) = fd[i].cb;
+      double t0 = fl_loop_stat_start();
+      cb(f, fd[i].arg);
+      fl_loop_stat_end(FL_LOOP_FD, (const void*)cb, t0);
     }
   }
   return n;
@@ -282,7 +323,7 @@ int fl_wait(double time_to_wait) {
 
 // fl_ready() is just like fl_wait(0.0) except no callbacks are done:
 int fl_ready() {
-  if (XQLength(fl_display)) return 1;
+  if (fl_display && XQLength(fl_display)) return 1;
   if (!nfds) return 0; // nothing to select or poll
 #  if USE_POLL
   return ::poll(pollfds, nfds, 0);
@@ -2037,6 +2078,9 @@ fprintf(stderr,"\n");*/
     break;
 
   case MotionNotify:
+#  if CONSOLIDATE_MOTION
+    if (send_motion) fl_compressed_motion++; // previous motion not sent
+#  endif
     set_event_xy();
 #  if CONSOLIDATE_MOTION
     send_motion = fl_xmousewin = window;
@@ -2171,7 +2215,7 @@ void Fl_Window::resize(int X,int Y,int W,int H) {
     Fl_Group::resize(X,Y,W,H);
     if (shown()) {redraw();}
   } else {
-    x(X); y(Y);
+    Fl_Widget::resize(X, Y, w(), h()); // tell the parent about the move
   }
 
   if (resize_from_program && is_a_resize && !resizable()) {
@@ -2224,6 +2268,7 @@ static void send_wm_state_event(Window wnd, int add, Atom prop) {
 int Fl_X::ewmh_supported() {
   static int result = -1;
 
+  if (Fl_Headless::enabled()) return 0;
   if (result == -1) {
     fl_open_display();
     result = 0;
@@ -2948,6 +2993,11 @@ void Fl_Window::show() {
   }
   Fl_Tooltip::exit(this);
   if (!shown()) {
+    if (Fl_Headless::enabled()) {
+      // there is no display, the window is only made visible
+      Fl_Widget::show();
+      return;
+    }
     fl_open_display();
     // Don't set background pixel for double-buffered windows...
     if (type() != FL_DOUBLE_WINDOW && can_boxcheat(box())) {
@@ -0,0 +1,55 @@
+//
+// "$Id$"
+//
+// Internal event loop statistics hooks for the Fast Light Tool Kit (FLTK).
+//
+// Copyright 1998-2016 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+// Measuring a callback looks like this, and costs a test of a global
+// flag when statistics are not collected:
+//
+//   double t0 = fl_loop_stat_start();
+//   cb(data);
+//   fl_loop_stat_end(FL_LOOP_TIMEOUT, (const void*)cb, t0);
+
+#ifndef fl_loop_stats_h
+#  define fl_loop_stats_h
+
+#  include <FL/Fl_Loop_Stats.H>
+#  include <stdio.h>
+
+extern char fl_loop_stats_on;
+extern double fl_loop_stat_time();
+extern void fl_loop_stat_add(int kind, const void *key, double start);
+
+// Shared by the loop statistics and Fl_Event_Recorder: add the duration
+// t (in seconds) to count, total, max and the histogram, and print the
+// non-empty histogram buckets.
+extern void fl_loop_stat_count(unsigned long &count, double &total, double &max,
+                               unsigned long *histogram, double t);
+extern void fl_loop_stat_print_histogram(FILE *f, const unsigned long *histogram);
+
+inline double fl_loop_stat_start() {
+  return fl_loop_stats_on ? fl_loop_stat_time() : 0.0;
+}
+
+inline void fl_loop_stat_end(int kind, const void *key, double start) {
+  if (start > 0.0) fl_loop_stat_add(kind, key, start);
+}
+
+#endif // !fl_loop_stats_h
+
+//
+// End of "$Id$".
+//
@@ -39,6 +39,7 @@
 #include <stdlib.h>
 #include <ctype.h>
 #include "flstring.h"
+#include "Fl_Shortcut_Index.H"
 #if !defined(WIN32) && !defined(__APPLE__)
 #include <FL/x.H>
 #endif
@@ -53,6 +54,11 @@
 */
 int Fl::test_shortcut(unsigned int shortcut) {
   if (!shortcut) return 0;
+  if (Fl_Shortcut_Index::collecting) {
+    Fl_Shortcut_Index::current->record(shortcut & FL_KEY_MASK,
+                                       shortcut & (FL_META|FL_ALT|FL_CTRL));
+    return 0;
+  }
 
   unsigned int v = shortcut & FL_KEY_MASK;
   if (((unsigned)fl_tolower(v))!=v) {
@@ -455,6 +461,10 @@ unsigned int Fl_Widget::label_shortcut(const char *t) {
 */
 int Fl_Widget::test_shortcut(const char *t, const bool require_alt) {
   if (!t) return 0;
+  if (Fl_Shortcut_Index::collecting) {
+    Fl_Shortcut_Index::current->record(label_shortcut(t), ~0U);
+    return 0;
+  }
   // for menubars etc. shortcuts must work only if the Alt modifier is pressed
   if (require_alt && Fl::event_state(FL_ALT)==0) return 0;
   unsigned int c = fl_utf8decode(Fl::event_text(), Fl::event_text()+Fl::event_length(), 0);
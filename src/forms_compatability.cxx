@@ -42,10 +42,7 @@ void Fl_Group::forms_end() {
       if (o->x()+o->w() > rw) rw = o->x()+o->w();
       if (o->y()+o->h() > rh) rh = o->y()+o->h();
     }
-    x(rx);
-    y(ry);
-    w(rw-rx);
-    h(rh-ry);
+    Fl_Widget::resize(rx, ry, rw-rx, rh-ry);
   }
   // flip all the children's coordinate systems:
   if (fl_flip) {
@@ -182,6 +182,7 @@ void Fl_Glut_Window::_init() {
   special = 0;
   mouse_down = 0;
   mode(glut_mode);
+  set_flag(SHORTCUT_HANDLER); // keyboard() and special() get all keys
 }
 
 /** Creates a glut window, registers to the glut windows list.*/
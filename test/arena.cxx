@@ -0,0 +1,123 @@
+//
+// "$Id$"
+//
+// Fl_Widget_Arena benchmark for the Fast Light Tool Kit (FLTK).
+//
+// Builds and deletes a large form many times, once with plain new and
+// once with the widgets allocated from an Fl_Widget_Arena, and prints
+// the times and the peak memory use:
+//
+//     arena [widgets [rounds [arena|new]]]
+//
+// The peak memory only grows, run each mode alone to compare it.
+//
+// Copyright 1998-2016 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Window.H>
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Box.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Input.H>
+#include <FL/Fl_Browser.H>
+#include <FL/Fl_Widget_Arena.H>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if !defined(WIN32)
+#  include <sys/resource.h>
+#endif
+
+// Peak resident memory of the process in kB, or 0 if unknown:
+static long peak_memory() {
+#if !defined(WIN32)
+  struct rusage ru;
+  if (getrusage(RUSAGE_SELF, &ru) == 0) {
+#  ifdef __APPLE__
+    return ru.ru_maxrss / 1024;	// bytes
+#  else
+    return ru.ru_maxrss;	// kB
+#  endif
+  }
+#endif
+  return 0;
+}
+
+static double seconds(clock_t t) {
+  return double(clock() - t) / CLOCKS_PER_SEC;
+}
+
+static void row_cb(int line, Fl_Browser_Row *row, void *) {
+  static char text[32];
+  sprintf(text, "line %d", line);
+  row->text = text;
+}
+
+// Creates n widgets in rows of 10 groups, from the arena if there is one,
+// and a browser in virtual mode, which is a plain widget in either case:
+static Fl_Window *build(int n, Fl_Widget_Arena *arena) {
+  Fl_Window *win = new Fl_Window(800, 600, "arena");
+  if (arena) win->arena(arena);
+  Fl_Browser *b = new Fl_Browser(0, 0, 800, 100);
+  b->virtual_rows(n, row_cb);
+  for (int i = 0; i < n; i += 30) {
+    Fl_Group *g = arena ? new (arena) Fl_Group(0, 0, 800, 20)
+			: new Fl_Group(0, 0, 800, 20);
+    for (int j = 0; j < 10; j++) {
+      int x = j * 80;
+      if (arena) {
+	new (arena) Fl_Box(x, 0, 20, 20, "box");
+	new (arena) Fl_Button(x + 20, 0, 20, 20, "b");
+	new (arena) Fl_Input(x + 40, 0, 40, 20);
+      } else {
+	new Fl_Box(x, 0, 20, 20, "box");
+	new Fl_Button(x + 20, 0, 20, 20, "b");
+	new Fl_Input(x + 40, 0, 40, 20);
+      }
+    }
+    g->end();
+  }
+  win->end();
+  return win;
+}
+
+static void run(const char *name, int n, int rounds, int use_arena) {
+  double t_build = 0, t_delete = 0;
+  for (int r = 0; r < rounds; r++) {
+    clock_t t = clock();
+    Fl_Window *win = build(n, use_arena ? new Fl_Widget_Arena : 0);
+    t_build += seconds(t);
+    t = clock();
+    delete win;			// deletes the arena too
+    t_delete += seconds(t);
+  }
+  printf("%-6s %8d widgets: build %7.3f s, delete %7.3f s, peak memory %ld kB\n",
+	 name, n, t_build, t_delete, peak_memory());
+}
+
+int main(int argc, char **argv) {
+  int n = argc > 1 ? atoi(argv[1]) : 30000;
+  int rounds = argc > 2 ? atoi(argv[2]) : 10;
+  if (n < 30) n = 30;
+  const char *mode = argc > 3 ? argv[3] : "";
+  if (rounds < 1) rounds = 1;
+  if (strcmp(mode, "new")) run("arena", n, rounds, 1);
+  if (strcmp(mode, "arena")) run("new", n, rounds, 0);
+  return 0;
+}
+
+//
+// End of "$Id$".
+//
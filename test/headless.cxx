@@ -0,0 +1,110 @@
+//
+// "$Id$"
+//
+// Fl_Headless test program for the Fast Light Tool Kit (FLTK).
+//
+// Runs a small form without a display: clicks a button, types into an
+// input field and resizes the window with deferred layout, then draws
+// the window into an Fl_Headless_Surface and checks the pixels. Prints
+// one line per check and exits with a non-zero status if one failed.
+//
+// Copyright 1998-2016 by Bill Spitzak and others.
+//
+// This library is free software. Distribution and use rights are outlined in
+// the file "COPYING" which should have been included with this file.  If this
+// file is missing or damaged, see the license at:
+//
+//     http://www.fltk.org/COPYING.php
+//
+// Please report all bugs and problems on the following page:
+//
+//     http://www.fltk.org/str.php
+//
+
+#include <FL/Fl.H>
+#include <FL/Fl_Headless.H>
+#include <FL/Fl_Window.H>
+#include <FL/Fl_Group.H>
+#include <FL/Fl_Box.H>
+#include <FL/Fl_Button.H>
+#include <FL/Fl_Input.H>
+#include <stdio.h>
+#include <string.h>
+
+static int failures = 0;
+
+static void check(const char *what, int ok) {
+  printf("%-40s %s\n", what, ok ? "ok" : "FAILED");
+  if (!ok) failures++;
+}
+
+// Returns non-zero if pixel x,y of the surface has color c:
+static int pixel_is(const Fl_Headless_Surface &surf, int x, int y, Fl_Color c) {
+  uchar r, g, b;
+  Fl::get_color(c, r, g, b);
+  const uchar *p = surf.data() + (y * surf.w() + x) * 3;
+  return p[0] == r && p[1] == g && p[2] == b;
+}
+
+static void button_cb(Fl_Widget *, void *v) {
+  Fl_Box *box = (Fl_Box *)v;
+  box->color(box->color() == FL_RED ? FL_BLUE : FL_RED);
+  box->redraw();
+}
+
+int main(int, char **) {
+  Fl_Headless::enable();
+  Fl_Window *win = new Fl_Window(200, 150, "headless");
+  Fl_Box *box = new Fl_Box(100, 10, 40, 30);
+  box->box(FL_FLAT_BOX);
+  box->color(FL_RED);
+  Fl_Button *button = new Fl_Button(10, 10, 80, 30, "toggle");
+  button->callback(button_cb, box);
+  Fl_Input *input = new Fl_Input(10, 50, 120, 25);
+  // a row that keeps the green box at the right edge:
+  Fl_Group *row = new Fl_Group(0, 100, 200, 40);
+  Fl_Box *space = new Fl_Box(0, 100, 160, 40);
+  Fl_Box *corner = new Fl_Box(160, 100, 40, 40);
+  corner->box(FL_FLAT_BOX);
+  corner->color(FL_GREEN);
+  row->resizable(space);
+  row->end();
+  win->resizable(row);
+  win->end();
+  win->show();
+
+  Fl_Headless_Surface surf(400, 150);
+  surf.set_current();
+  surf.draw(win);
+  check("box is red", pixel_is(surf, 120, 25, FL_RED));
+  check("green box at the right edge", pixel_is(surf, 180, 120, FL_GREEN));
+
+  Fl_Headless::push(win, 50, 25);
+  Fl_Headless::release(win, 50, 25);
+  surf.draw(win);
+  check("click on the button makes it blue", pixel_is(surf, 120, 25, FL_BLUE));
+
+  Fl_Headless::push(win, 50, 60);
+  Fl_Headless::release(win, 50, 60);
+  Fl_Headless::key(win, 'h', "h");
+  Fl_Headless::key(win, 'i', "i");
+  check("keys are typed into the input", !strcmp(input->value(), "hi"));
+
+  // the children are placed when the surface draws the window:
+  Fl::deferred_layout(1);
+  Fl_Headless::resize(win, 300, 150);
+  surf.clear();
+  surf.draw(win);
+  check("resize moves the green box", pixel_is(surf, 280, 120, FL_GREEN));
+  check("nothing is left at the old place", !pixel_is(surf, 180, 120, FL_GREEN));
+  Fl::deferred_layout(0);
+
+  Fl_Display_Device::display_device()->set_current();
+  delete win;
+  printf("%d check(s) failed\n", failures);
+  return failures ? 1 : 0;
+}
+
+//
+// End of "$Id$".
+//